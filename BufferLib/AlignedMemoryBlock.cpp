@@ -0,0 +1,240 @@
+#include "AlignedMemoryBlock.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// Explicit huge pages are asked for at 2MB, rather than the system's default
+// size, which can be 1GB, or 512MB on some arm64 kernels.  Without a way to
+// ask for the size, only transparent huge pages are tried.
+#if defined(MAP_HUGETLB) && !defined(MAP_HUGE_2MB) && defined(MAP_HUGE_SHIFT)
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+namespace
+{
+	const size_t kHugePageSize = 2 * 1024 * 1024;
+
+	bool isPowerOfTwo(size_t value)
+	{
+		return (value != 0) && ((value & (value - 1)) == 0);
+	}
+
+	size_t roundUp(size_t value, size_t multiple)
+	{
+		return ((value + multiple - 1) / multiple) * multiple;
+	}
+}
+
+AlignedMemoryBlock::AlignedMemoryBlock(size_t length, size_t alignment, PageMode pageMode)
+	: _pMemory{ nullptr },
+	_capacity{ length },
+	_length{ length },
+	_alignment{ alignment < sizeof(void*) ? sizeof(void*) : alignment },
+	_allocationLength{ 0 },
+	_allocation{ Allocation::Heap },
+	_resource{ nullptr },
+	_hugePages{ false }
+{
+	if (!isPowerOfTwo(alignment))
+	{
+		throw std::invalid_argument("AlignedMemoryBlock alignment must be a power of two");
+	}
+	if (pageMode == PageMode::HugePages)
+	{
+		allocateHugePages();
+	}
+	if (_pMemory == nullptr)
+	{
+		allocateHeap();
+	}
+}
+
+AlignedMemoryBlock::AlignedMemoryBlock(size_t length, size_t alignment, IMemoryResource * pResource)
+	: _pMemory{ nullptr },
+	_capacity{ length },
+	_length{ length },
+	_alignment{ alignment < sizeof(void*) ? sizeof(void*) : alignment },
+	_allocationLength{ roundUp(length == 0 ? 1 : length, _alignment) },
+	_allocation{ Allocation::Resource },
+	_resource{ pResource },
+	_hugePages{ false }
+{
+	if (!isPowerOfTwo(alignment))
+	{
+		throw std::invalid_argument("AlignedMemoryBlock alignment must be a power of two");
+	}
+	_pMemory = static_cast<char*>(_resource->allocate(_allocationLength, _alignment));
+}
+
+AlignedMemoryBlock::~AlignedMemoryBlock()
+{
+	switch (_allocation)
+	{
+	case Allocation::Resource:
+		_resource->deallocate(_pMemory, _allocationLength, _alignment);
+		break;
+#ifdef _WIN32
+	case Allocation::LargePages:
+		VirtualFree(_pMemory, 0, MEM_RELEASE);
+		break;
+	case Allocation::Heap:
+		_aligned_free(_pMemory);
+		break;
+#else
+	case Allocation::Mapped:
+		munmap(_pMemory, _allocationLength);
+		break;
+	case Allocation::Heap:
+		free(_pMemory);
+		break;
+#endif
+	default:
+		break;
+	}
+}
+
+void AlignedMemoryBlock::allocateHugePages()
+{
+#ifdef _WIN32
+	// Needs SeLockMemoryPrivilege, so commonly fails and falls back to the heap
+	auto largePageSize = GetLargePageMinimum();
+	if ((largePageSize == 0) || (_alignment > largePageSize))
+	{
+		return;
+	}
+	auto allocationLength = roundUp(_capacity == 0 ? 1 : _capacity, largePageSize);
+	auto pMemory = VirtualAlloc(nullptr, allocationLength, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+	if (pMemory != nullptr)
+	{
+		_pMemory = static_cast<char*>(pMemory);
+		_allocationLength = allocationLength;
+		_allocation = Allocation::LargePages;
+		_hugePages = true;
+	}
+#else
+	auto pageAlignment = (_alignment > kHugePageSize) ? _alignment : kHugePageSize;
+	auto allocationLength = roundUp(_capacity == 0 ? 1 : _capacity, kHugePageSize);
+
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_2MB)
+	if (pageAlignment == kHugePageSize)
+	{
+		auto pMemory = mmap(nullptr, allocationLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+		if (pMemory != MAP_FAILED)
+		{
+			_pMemory = static_cast<char*>(pMemory);
+			_allocationLength = allocationLength;
+			_allocation = Allocation::Mapped;
+			_hugePages = true;
+			return;
+		}
+	}
+#endif
+
+#ifdef MADV_HUGEPAGE
+	// No reserved huge pages.  Map with room to align to a huge page boundary,
+	// trim the excess and ask for transparent huge pages.
+	auto mappedLength = allocationLength + pageAlignment;
+	auto pMapped = mmap(nullptr, mappedLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pMapped == MAP_FAILED)
+	{
+		return;
+	}
+	auto start = reinterpret_cast<uintptr_t>(pMapped);
+	auto alignedStart = roundUp(start, pageAlignment);
+	auto head = alignedStart - start;
+	auto tail = mappedLength - head - allocationLength;
+	if (head > 0)
+	{
+		munmap(pMapped, head);
+	}
+	if (tail > 0)
+	{
+		munmap(reinterpret_cast<char*>(alignedStart + allocationLength), tail);
+	}
+	_pMemory = reinterpret_cast<char*>(alignedStart);
+	_allocationLength = allocationLength;
+	_allocation = Allocation::Mapped;
+	_hugePages = (madvise(_pMemory, _allocationLength, MADV_HUGEPAGE) == 0);
+#endif
+#endif
+}
+
+void AlignedMemoryBlock::allocateHeap()
+{
+	// Never allocate zero bytes, so an empty block still has a valid aligned address
+	auto allocationLength = roundUp(_capacity == 0 ? 1 : _capacity, _alignment);
+#ifdef _WIN32
+	_pMemory = static_cast<char*>(_aligned_malloc(allocationLength, _alignment));
+#else
+	void* pMemory = nullptr;
+	if (posix_memalign(&pMemory, _alignment, allocationLength) == 0)
+	{
+		_pMemory = static_cast<char*>(pMemory);
+	}
+#endif
+	if (_pMemory == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	_allocation = Allocation::Heap;
+}
+
+char * AlignedMemoryBlock::getWritableMemory()
+{
+	return _pMemory;
+}
+
+size_t AlignedMemoryBlock::getCapacity() const
+{
+	return _capacity;
+}
+
+void AlignedMemoryBlock::setLength(size_t length)
+{
+	_length = (length > _capacity) ? _capacity : length;
+}
+
+bool AlignedMemoryBlock::isHugePageBacked() const
+{
+	return _hugePages;
+}
+
+const char * AlignedMemoryBlock::getMemory() const
+{
+	return _pMemory;
+}
+
+size_t AlignedMemoryBlock::getLength() const
+{
+	return _length;
+}
+
+size_t AlignedMemoryBlock::copy(size_t sourceOffset, size_t sourceLength, char * pDestination) const
+{
+	if (sourceOffset >= _length)
+	{
+		return 0;
+	}
+	auto toCopy = ((_length - sourceOffset) < sourceLength) ? _length - sourceOffset : sourceLength;
+	memcpy(pDestination, _pMemory + sourceOffset, toCopy);
+	return toCopy;
+}
+
+const char & AlignedMemoryBlock::operator[](size_t offset) const
+{
+	return _pMemory[offset];
+}
+
+size_t AlignedMemoryBlock::getAlignment() const
+{
+	return _alignment;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "IMemoryBlock.h"
+#include "MemoryResource.h"
+
+	// Owned, writable memory block whose start is aligned to a given power of
+	// two, such as the sector size needed for unbuffered (O_DIRECT) reads.
+	// Optionally backed by huge pages to cut TLB misses on very large buffers.
+	class AlignedMemoryBlock : public IMemoryBlock
+	{
+	public:
+		enum class PageMode
+		{
+			Normal,
+			// Explicit huge pages if the system has them reserved, otherwise
+			// transparent huge pages where supported, otherwise normal pages
+			HugePages
+		};
+
+		AlignedMemoryBlock(size_t length, size_t alignment, PageMode pageMode = PageMode::Normal);
+		// Allocate the memory from pResource, e.g. a per-request arena
+		AlignedMemoryBlock(size_t length, size_t alignment, IMemoryResource* pResource);
+		AlignedMemoryBlock(const AlignedMemoryBlock&) = delete;
+		AlignedMemoryBlock& operator=(const AlignedMemoryBlock&) = delete;
+		virtual ~AlignedMemoryBlock();
+
+		char* getWritableMemory();
+		size_t getCapacity() const;
+		// Shrink the visible length, e.g. after a short read.  Never exceeds the capacity.
+		void setLength(size_t length);
+		bool isHugePageBacked() const;
+
+		// Inherited via IMemoryBlock
+		virtual const char* getMemory() const override;
+		virtual size_t getLength() const override;
+		virtual size_t copy(size_t sourceOffset, size_t sourceLength, char* pDestination) const override;
+		virtual const char& operator[](size_t offset) const override;
+		virtual size_t getAlignment() const override;
+
+	private:
+		enum class Allocation { Heap, Mapped, LargePages, Resource };
+
+		void allocateHugePages();
+		void allocateHeap();
+
+		char* _pMemory;
+		size_t _capacity;
+		size_t _length;
+		size_t _alignment;
+		// Size of the underlying allocation when it is not from the heap
+		size_t _allocationLength;
+		Allocation _allocation;
+		IMemoryResource* _resource;
+		bool _hugePages;
+	};
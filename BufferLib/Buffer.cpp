@@ -2,102 +2,182 @@
 #include "BufferFragment.h"
 #include "IMemoryBlock.h"
 
+#include <algorithm>
+#include <stdexcept>
 #include <sstream>
 extern std::ostringstream gDebug;
 
-Buffer::Buffer(std::shared_ptr<IMemoryBlock> pMemoryBlock)
+Buffer::Buffer()
+	: Buffer(getDefaultMemoryResource())
+{
+}
+
+Buffer::Buffer(IMemoryResource * pResource)
+	: _fragments{ ResourceAllocator<BufferFragment>(pResource) },
+	_fragmentEnds{ ResourceAllocator<size_t>(pResource) }
+{
+}
+
+Buffer::Buffer(std::shared_ptr<IMemoryBlock> pMemoryBlock, IMemoryResource * pResource)
+	: Buffer(pResource)
 {
 	BufferFragment frag(pMemoryBlock, 0, pMemoryBlock->getLength());
-	_fragments.push_back(frag);
+	appendFragment(frag);
+}
+
+Buffer::Buffer(const Buffer & srcBuffer, IMemoryResource * pResource)
+	: _fragments{ srcBuffer._fragments, ResourceAllocator<BufferFragment>(pResource) },
+	_fragmentEnds{ srcBuffer._fragmentEnds, ResourceAllocator<size_t>(pResource) }
+{
+}
+
+Buffer::Buffer(const Buffer & srcBuffer, const const_itr & copyFrom, IMemoryResource * pResource)
+	: Buffer(srcBuffer, copyFrom, srcBuffer.cend(), pResource)
+{
+}
+
+
+Buffer::Buffer(const Buffer & srcBuffer, const const_itr & copyFrom, const const_itr & copyTo, IMemoryResource * pResource)
+	: Buffer((pResource == nullptr) ? srcBuffer.getMemoryResource() : pResource)
+{
+	auto offsetFrom = srcBuffer.getOffset(copyFrom);
+	auto offsetTo = srcBuffer.getOffset(copyTo);
+	if (offsetTo > offsetFrom)
+	{
+		*this = srcBuffer.slice(offsetFrom, offsetTo - offsetFrom, getMemoryResource());
+	}
 }
 
-Buffer::Buffer(const Buffer & srcBuffer, const const_itr & copyFrom)
-	: Buffer(srcBuffer, copyFrom, srcBuffer.cend())
+Buffer Buffer::slice(size_t offset, size_t length, IMemoryResource * pResource) const
 {
+	return slice(offset, length, BufferFragment::SliceMode::Reference, pResource);
 }
 
+Buffer Buffer::slice(size_t offset, size_t length, BufferFragment::SliceMode mode, IMemoryResource * pResource) const
+{
+	Buffer result{ (pResource == nullptr) ? getMemoryResource() : pResource };
+	result.reserve(countFragments(offset, length));
+	result.appendSlice(*this, offset, length, mode);
+	return result;
+}
 
-Buffer::Buffer(const Buffer & srcBuffer, const const_itr & copyFrom, const const_itr & copyTo)
+Buffer Buffer::subspan(size_t offset) const
 {
-	const_itr fragmentEnd{ srcBuffer.cbegin() };
+	return slice(offset, getLength());
+}
 
-	for (BufferFragment srcFragment : srcBuffer._fragments)
+Buffer Buffer::subspan(size_t offset, size_t length) const
+{
+	return slice(offset, length);
+}
+
+Buffer Buffer::replace(size_t offset, size_t length, const Buffer & replacement, IMemoryResource * pResource) const
+{
+	if (offset > getLength())
 	{
-		const_itr fragmentStart{ fragmentEnd };
-		fragmentEnd += srcFragment.getLength();
-		if (copyFrom >= fragmentEnd)
-		{
-			// Not yet at start of required fragment
-			continue;
-		}
-		if ((copyTo >= fragmentEnd) && (copyFrom <= fragmentStart))
-		{
-			// Copy all of this fragment
-			_fragments.push_back(srcFragment);
-		}
-		else if (copyTo < fragmentStart)
-		{
-			// Copied all we want
-			break;
-		}
-		else
-		{
-			// Copy a partial fragment
-			size_t offset = (copyFrom <= fragmentStart) ? 0 : copyFrom - fragmentStart;
-			size_t length = (copyTo >= fragmentEnd) ? srcFragment.getLength() - offset : (copyTo - fragmentStart) - offset;
-			BufferFragment newFrag(srcFragment, offset, length);
-			_fragments.push_back(newFrag);
-		}
+		throw std::out_of_range("Buffer edit offset is past the end");
 	}
+	// Built in one pass, with the fragment list allocated once at its final size
+	auto bufferLength = getLength();
+	auto tailOffset = (length < bufferLength - offset) ? offset + length : bufferLength;
+	Buffer result{ (pResource == nullptr) ? getMemoryResource() : pResource };
+	result.reserve(countFragments(0, offset) + replacement._fragments.size() + countFragments(tailOffset, bufferLength - tailOffset));
+	result.appendSlice(*this, 0, offset, BufferFragment::SliceMode::Reference);
+	result += replacement;
+	result.appendSlice(*this, tailOffset, bufferLength - tailOffset, BufferFragment::SliceMode::Reference);
+	return result;
+}
+
+Buffer Buffer::insert(size_t offset, const Buffer & insertion, IMemoryResource * pResource) const
+{
+	return replace(offset, 0, insertion, pResource);
+}
+
+Buffer Buffer::erase(size_t offset, size_t length, IMemoryResource * pResource) const
+{
+	return replace(offset, length, Buffer{}, pResource);
 }
 
 Buffer & Buffer::operator+=(const Buffer & srcBuffer)
 {
-	// Copy to temp vector so it works if a buffer is appended to itself
-	std::vector<BufferFragment> temp(srcBuffer._fragments);
-	_fragments.reserve(_fragments.size() + temp.size());
-	_fragments.insert(_fragments.end(), temp.begin(), temp.end());
+	// Reserve first and append by index, so it works if a buffer is appended to itself.
+	// Grow geometrically, so building a buffer by repeated appends stays linear.
+	auto count = srcBuffer._fragments.size();
+	auto needed = _fragments.size() + count;
+	if (needed > _fragments.capacity())
+	{
+		needed = std::max(needed, 2 * _fragments.capacity());
+		_fragments.reserve(needed);
+		_fragmentEnds.reserve(needed);
+	}
+	for (size_t index = 0; index < count; ++index)
+	{
+		appendFragment(srcBuffer._fragments[index]);
+	}
+	return *this;
+}
+
+Buffer & Buffer::append(std::shared_ptr<IMemoryBlock> pMemoryBlock)
+{
+	appendFragment(BufferFragment(pMemoryBlock, 0, pMemoryBlock->getLength()));
 	return *this;
 }
 
+Buffer & Buffer::append(std::shared_ptr<IMemoryBlock> pMemoryBlock, size_t offset, size_t length)
+{
+	appendFragment(BufferFragment(pMemoryBlock, offset, length));
+	return *this;
+}
+
+void Buffer::reserve(size_t fragmentCount)
+{
+	_fragments.reserve(fragmentCount);
+	_fragmentEnds.reserve(fragmentCount);
+}
+
 size_t Buffer::getLength() const
 {
-	size_t length = 0;
-	for (BufferFragment frag : _fragments)
-	{
-		length += frag.getLength();
-	}
-	return length;
+	return _fragmentEnds.empty() ? 0 : _fragmentEnds.back();
+}
+
+const Buffer::FragmentVector& Buffer::getFragments() const
+{
+	return _fragments;
+}
+
+IMemoryResource * Buffer::getMemoryResource() const
+{
+	return _fragments.get_allocator().getResource();
 }
 
 const char & Buffer::operator[](size_t offset) const
 {
-	auto fragOffset = offset;
-	for (auto frag : _fragments)
+	auto index = findFragment(offset);
+	if (index < _fragments.size())
 	{
-		auto fragLength = frag.getLength();
-		if (fragOffset < fragLength)
-		{
-			return frag[fragOffset];
-		}
-		fragOffset -= fragLength;
+		return _fragments[index][offset - getFragmentStart(index)];
 	}
 	// TODO: Read past end of buffer
-	return 0;
+	static const char pastEnd = 0;
+	return pastEnd;
 }
 
 size_t Buffer::copy(size_t offset, size_t length, char * pDestination) const
 {
-	auto fragOffset = offset;
 	auto bytesToWrite = length;
 	auto pFragDest = pDestination;
 
-	for (auto frag : _fragments)
+	auto index = findFragment(offset);
+	if (index < _fragments.size())
 	{
-		auto fragLength = frag.getLength();
-		if (fragOffset < fragLength)
+		auto fragOffset = offset - getFragmentStart(index);
+		for (; index < _fragments.size(); ++index)
 		{
-			auto fragBytesWritten = frag.copy(fragOffset, bytesToWrite, pFragDest);
+			if (index + 1 < _fragments.size())
+			{
+				_fragments[index + 1].prefetch();
+			}
+			auto fragBytesWritten = _fragments[index].copy(fragOffset, bytesToWrite, pFragDest);
 			bytesToWrite -= fragBytesWritten;
 			if (bytesToWrite == 0)
 			{
@@ -106,19 +186,134 @@ size_t Buffer::copy(size_t offset, size_t length, char * pDestination) const
 			pFragDest += fragBytesWritten;
 			fragOffset = 0;
 		}
+	}
+
+	return length - bytesToWrite;
+}
+
+const char * Buffer::getContiguous(size_t offset, size_t * length) const
+{
+	*length = 0;
+	auto index = findFragment(offset);
+	if (index >= _fragments.size())
+	{
+		return nullptr;
+	}
+	auto fragOffset = offset - getFragmentStart(index);
+	auto pMemory = _fragments[index].getMemory();
+	if (pMemory == nullptr)
+	{
+		return nullptr;
+	}
+	*length = _fragments[index].getLength() - fragOffset;
+	// Callers walking the buffer segment by segment will ask for the next fragment next
+	if (index + 1 < _fragments.size())
+	{
+		_fragments[index + 1].prefetch();
+	}
+	return pMemory + fragOffset;
+}
+
+void Buffer::willNeed(size_t offset, size_t length) const
+{
+	auto index = findFragment(offset);
+	if (index >= _fragments.size())
+	{
+		return;
+	}
+	auto fragOffset = offset - getFragmentStart(index);
+	for (; (index < _fragments.size()) && (length > 0); ++index)
+	{
+		auto& fragment = _fragments[index];
+		auto fragLength = std::min(length, fragment.getLength() - fragOffset);
+		if (!fragment.isInline())
+		{
+			fragment.getMemoryBlock()->willNeed(fragment.getOffset() + fragOffset, fragLength);
+		}
+		length -= fragLength;
+		fragOffset = 0;
+	}
+}
+
+void Buffer::appendSlice(const Buffer & source, size_t offset, size_t length, BufferFragment::SliceMode mode)
+{
+	auto bufferLength = source.getLength();
+	if ((offset >= bufferLength) || (length == 0))
+	{
+		return;
+	}
+	if (length > bufferLength - offset)
+	{
+		length = bufferLength - offset;
+	}
+	auto endOffset = offset + length;
+
+	auto first = source.findFragment(offset);
+	auto last = source.findFragment(endOffset - 1);
+	for (auto index = first; index <= last; ++index)
+	{
+		const BufferFragment& srcFragment = source._fragments[index];
+		auto fragmentStart = source.getFragmentStart(index);
+		auto fragmentEnd = source._fragmentEnds[index];
+		if ((offset <= fragmentStart) && (endOffset >= fragmentEnd) &&
+			((mode == BufferFragment::SliceMode::Reference) || (srcFragment.getLength() > BufferFragment::kInlineCapacity)))
+		{
+			// Copy all of this fragment
+			appendFragment(srcFragment);
+		}
 		else
 		{
-			fragOffset -= fragLength;
+			// Copy a partial fragment, or a small one to be stored inline
+			auto fragOffset = (offset <= fragmentStart) ? 0 : offset - fragmentStart;
+			auto fragLength = ((endOffset >= fragmentEnd) ? fragmentEnd : endOffset) - fragmentStart - fragOffset;
+			BufferFragment newFrag(srcFragment, fragOffset, fragLength, mode);
+			appendFragment(newFrag);
 		}
 	}
+}
 
-	return length - bytesToWrite;
+size_t Buffer::countFragments(size_t offset, size_t length) const
+{
+	auto bufferLength = getLength();
+	if ((offset >= bufferLength) || (length == 0))
+	{
+		return 0;
+	}
+	auto endOffset = (length < bufferLength - offset) ? offset + length : bufferLength;
+	return findFragment(endOffset - 1) - findFragment(offset) + 1;
+}
+
+void Buffer::appendFragment(const BufferFragment & fragment)
+{
+	if (fragment.getLength() == 0)
+	{
+		return;
+	}
+	_fragments.push_back(fragment);
+	_fragmentEnds.push_back(getLength() + fragment.getLength());
+}
+
+size_t Buffer::findFragment(size_t offset) const
+{
+	// First fragment ending beyond offset
+	auto found = std::upper_bound(_fragmentEnds.cbegin(), _fragmentEnds.cend(), offset);
+	return found - _fragmentEnds.cbegin();
+}
+
+size_t Buffer::getFragmentStart(size_t index) const
+{
+	return (index == 0) ? 0 : _fragmentEnds[index - 1];
 }
 
+size_t Buffer::getOffset(const const_itr & itr) const
+{
+	size_t index = itr._fragmentIterator - _fragments.cbegin();
+	return getFragmentStart(index) + itr._fragmentOffset;
+}
 
 Buffer operator+(const Buffer& lhs, const Buffer& rhs)
 {
-	Buffer result(lhs);
+	Buffer result(lhs, lhs.getMemoryResource());
 	result += rhs;
 	return result;
 }
@@ -126,14 +321,20 @@ Buffer operator+(const Buffer& lhs, const Buffer& rhs)
 Buffer::const_itr Buffer::cbegin() const
 {
 	const_itr result(*this);
+	// operator++ prefetches the fragment after the one it moves into, so the
+	// second fragment would never be prefetched.  Start it loading here.
+	if (_fragments.size() > 1)
+	{
+		_fragments[1].prefetch();
+	}
 	return result;
 }
 
 Buffer::const_itr  Buffer::cend() const
 {
+	// Empty fragments are never stored, so the end is always one past the last fragment
 	const_itr result(*this);
-	// This seems a little inneficient.
-	result += getLength();
+	result._fragmentIterator = _fragments.cend();
 	return result;
 }
 
@@ -146,21 +347,6 @@ Buffer::const_itr::const_itr(const Buffer & xBuffer)
 	_fragmentOffset{0}
 {}
 
-Buffer::const_itr & Buffer::const_itr::operator++()
-{
-	if (*this != _buffer->cend())
-	{
-		++_fragmentOffset;
-		if (_fragmentOffset >= _fragmentIterator->getLength())
-		{
-			++_fragmentIterator;
-			_fragmentOffset = 0;
-		}
-		// else we're at the end.  Just don't increment
-	}
-	return *this;
-}
-
 Buffer::const_itr Buffer::const_itr::operator++(int)
 {
 	const_itr result{ *this };
@@ -190,11 +376,6 @@ Buffer::const_itr Buffer::const_itr::operator--(int)
 	return result;
 }
 
-const char & Buffer::const_itr::operator*() const
-{
-	return (*_fragmentIterator)[_fragmentOffset];
-}
-
 const char & Buffer::const_itr::operator[](difference_type xIndex) const
 {
 	auto offset = _fragmentOffset;
@@ -3,14 +3,24 @@
 #include <vector>
 #include <memory>
 #include "BufferFragment.h"
+#include "MemoryResource.h"
 
 class IMemoryBlock;
 
 	class Buffer
 	{
 	public:
-		// Buffer construction
-		explicit Buffer(std::shared_ptr<IMemoryBlock> pMemoryBlock);
+		typedef std::vector<BufferFragment, ResourceAllocator<BufferFragment>> FragmentVector;
+
+		// Buffer construction.  The list of fragments is allocated from pResource,
+		// which must outlive the buffer.  A plain copy uses the default resource,
+		// as std::pmr containers do, so copying a buffer out of an arena is safe;
+		// pass a resource to keep the source's.
+		Buffer();
+		explicit Buffer(IMemoryResource* pResource);
+		explicit Buffer(std::shared_ptr<IMemoryBlock> pMemoryBlock, IMemoryResource* pResource = getDefaultMemoryResource());
+		// Copy into a different memory resource
+		Buffer(const Buffer& srcBuffer, IMemoryResource* pResource);
 
 		class const_itr : public std::iterator<std::random_access_iterator_tag, char>
 		{
@@ -43,33 +53,86 @@ class IMemoryBlock;
 			friend bool operator<=(const const_itr& lhs, const const_itr& rhs);
 			friend bool operator>=(const const_itr& lhs, const const_itr& rhs);
 		private:
+			friend class Buffer;
 			const Buffer* _buffer;
-			std::vector<BufferFragment>::const_iterator _fragmentIterator;
+			FragmentVector::const_iterator _fragmentIterator;
 			difference_type _fragmentOffset;
 		};
 
 
-		// Construct sub-buffer (cut off start)
-		Buffer(const Buffer& srcBuffer, const const_itr& copyFrom);
+		// Construct sub-buffer (cut off start).  Sub-buffers, slices and edits use the
+		// memory resource of the source buffer unless another is given; subspan
+		// always uses the source's.
+		Buffer(const Buffer& srcBuffer, const const_itr& copyFrom, IMemoryResource* pResource = nullptr);
 		// Construct sub-buffer (cut start and end)
-		Buffer(const Buffer& srcBuffer, const const_itr& copyFrom, const const_itr& copyTo);
-
-		// Buffer concatenation
+		Buffer(const Buffer& srcBuffer, const const_itr& copyFrom, const const_itr& copyTo, IMemoryResource* pResource = nullptr);
+
+		// Sub-buffer by offset.  Fragments are located by binary search, so this
+		// is O(log n) in the number of fragments plus the fragments copied.
+		// Ranges past the end of the buffer are truncated.
+		Buffer slice(size_t offset, size_t length, IMemoryResource* pResource = nullptr) const;
+		// With SliceMode::Inline, fragments of the slice up to BufferFragment::kInlineCapacity
+		// bytes are copies, which don't keep their blocks alive or see later writes to them
+		Buffer slice(size_t offset, size_t length, BufferFragment::SliceMode mode, IMemoryResource* pResource = nullptr) const;
+		Buffer subspan(size_t offset) const;
+		Buffer subspan(size_t offset, size_t length) const;
+
+		// Edited copies of the buffer.  No bytes are copied: untouched fragments are
+		// shared with this buffer and only the fragments at the edges are split.  The
+		// fragment list isn't shared, so each edit copies it in one allocation and
+		// the cost is O(n) in the number of fragments, not in those touched.
+		// Throws std::out_of_range if offset is past the end; length is truncated.
+		Buffer replace(size_t offset, size_t length, const Buffer& replacement, IMemoryResource* pResource = nullptr) const;
+		Buffer insert(size_t offset, const Buffer& insertion, IMemoryResource* pResource = nullptr) const;
+		Buffer erase(size_t offset, size_t length, IMemoryResource* pResource = nullptr) const;
+
+		// Buffer concatenation.  The result of lhs + rhs uses lhs's memory resource.
 		Buffer& operator+=(const Buffer& srcBuffer);
+		// Append the whole of a memory block, without a temporary Buffer
+		Buffer& append(std::shared_ptr<IMemoryBlock> pMemoryBlock);
+		// Append part of a memory block.  The range is truncated to the block.
+		Buffer& append(std::shared_ptr<IMemoryBlock> pMemoryBlock, size_t offset, size_t length);
+		// Make room for fragmentCount fragments, so appending them allocates nothing
+		void reserve(size_t fragmentCount);
 
 		const_itr cbegin() const;
 		const_itr cend() const;
 
 
 		size_t getLength() const;
+		const FragmentVector& getFragments() const;
+		IMemoryResource* getMemoryResource() const;
 		const char& operator[](size_t offset) const;
 		size_t copy(size_t offset, size_t length, char* pDestination) const;
 		// return the address of a char at a given offset into the buffer,
-		// and the size of the contiguous buffer memory from this offset
-		//const char* getContiguous(size_t offset, size_t* length);
+		// and the size of the contiguous buffer memory from this offset.
+		// Returns nullptr past the end, or if the memory block has no direct access.
+		// Bulk work should loop over these segments: a plain loop over a segment
+		// vectorises, where a loop over const_itr doesn't.
+		const char* getContiguous(size_t offset, size_t* length) const;
+		// Call process(pData, length) for each contiguous segment of the range, in
+		// order.  Segments of blocks without direct access are copied to a
+		// temporary first, in pieces of up to 4KB.
+		template<typename F>
+		void forEachSegment(size_t offset, size_t length, F&& process) const;
+		// Hint that a range will be read soon, so memory blocks that can, such as
+		// mapped files, start reading it in.  Returns without waiting.
+		void willNeed(size_t offset, size_t length) const;
 		std::string asString() const;
 	private:
-		std::vector<BufferFragment> _fragments;
+		void appendFragment(const BufferFragment& fragment);
+		// Append the fragments of part of source, split at the ends as needed
+		void appendSlice(const Buffer& source, size_t offset, size_t length, BufferFragment::SliceMode mode);
+		// Number of fragments the range touches
+		size_t countFragments(size_t offset, size_t length) const;
+		// Index of the fragment containing offset, or the fragment count if past the end
+		size_t findFragment(size_t offset) const;
+		size_t getFragmentStart(size_t index) const;
+		size_t getOffset(const const_itr& itr) const;
+
+		FragmentVector _fragments;
+		// Offset just past the end of each fragment, so lookups can binary search
+		std::vector<size_t, ResourceAllocator<size_t>> _fragmentEnds;
 
 	};
 
@@ -78,3 +141,58 @@ class IMemoryBlock;
 	Buffer operator+(const Buffer& lhs, const Buffer& rhs);
 	Buffer::const_itr::difference_type operator-(const Buffer::const_itr & lhs, const Buffer::const_itr & rhs);
 
+
+	// Sequential access is inlined, so loops over a buffer need no function call per byte
+
+	inline Buffer::const_itr & Buffer::const_itr::operator++()
+	{
+		if (_fragmentIterator != _buffer->_fragments.cend())
+		{
+			++_fragmentOffset;
+			if (_fragmentOffset >= static_cast<difference_type>(_fragmentIterator->getLength()))
+			{
+				++_fragmentIterator;
+				_fragmentOffset = 0;
+				// Start loading the fragment after this one while this one is read
+				if ((_fragmentIterator != _buffer->_fragments.cend()) && (_fragmentIterator + 1 != _buffer->_fragments.cend()))
+				{
+					(_fragmentIterator + 1)->prefetch();
+				}
+			}
+			// else we're at the end.  Just don't increment
+		}
+		return *this;
+	}
+
+	inline const char & Buffer::const_itr::operator*() const
+	{
+		return (*_fragmentIterator)[_fragmentOffset];
+	}
+
+	template<typename F>
+	void Buffer::forEachSegment(size_t offset, size_t length, F&& process) const
+	{
+		auto bufferLength = getLength();
+		if (offset >= bufferLength)
+		{
+			return;
+		}
+		auto end = (length < bufferLength - offset) ? offset + length : bufferLength;
+		while (offset < end)
+		{
+			size_t segmentLength = 0;
+			auto pData = getContiguous(offset, &segmentLength);
+			char copied[4096];
+			if (pData == nullptr)
+			{
+				segmentLength = copy(offset, sizeof(copied), copied);
+				pData = copied;
+			}
+			if (segmentLength > end - offset)
+			{
+				segmentLength = end - offset;
+			}
+			process(pData, segmentLength);
+			offset += segmentLength;
+		}
+	}
@@ -0,0 +1,415 @@
+#include "BufferEncoding.h"
+#include "AlignedMemoryBlock.h"
+
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define BUFFERLIB_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(BUFFERLIB_SSE2) && (defined(__SSSE3__) || defined(__AVX__))
+#define BUFFERLIB_SSSE3
+#include <tmmintrin.h>
+#endif
+
+namespace
+{
+	const char kHexDigits[] = "0123456789abcdef";
+	const char kBase64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	const unsigned char kInvalid = 0xFF;
+
+	struct DecodeTables
+	{
+		unsigned char hex[256];
+		unsigned char base64[256];
+
+		DecodeTables()
+		{
+			memset(hex, kInvalid, sizeof(hex));
+			memset(base64, kInvalid, sizeof(base64));
+			for (unsigned char value = 0; value < 16; ++value)
+			{
+				hex[static_cast<unsigned char>(kHexDigits[value])] = value;
+				hex[static_cast<unsigned char>(toupper(kHexDigits[value]))] = value;
+			}
+			for (unsigned char value = 0; value < 64; ++value)
+			{
+				base64[static_cast<unsigned char>(kBase64Alphabet[value])] = value;
+			}
+		}
+	};
+
+	const DecodeTables& getDecodeTables()
+	{
+		static const DecodeTables tables;
+		return tables;
+	}
+
+	// Feeds a kernel whole groups of groupSize bytes, carrying a partial group
+	// from the end of one run to the start of the next
+	template<size_t groupSize, typename Kernel>
+	class GroupedRuns
+	{
+	public:
+		explicit GroupedRuns(Kernel kernel) : _kernel{ kernel }, _carried{ 0 } {}
+
+		void operator()(const char* pData, size_t length)
+		{
+			if (_carried > 0)
+			{
+				auto needed = groupSize - _carried;
+				auto taken = (length < needed) ? length : needed;
+				memcpy(_carry + _carried, pData, taken);
+				_carried += taken;
+				pData += taken;
+				length -= taken;
+				if (_carried < groupSize)
+				{
+					return;
+				}
+				_kernel(_carry, groupSize);
+				_carried = 0;
+			}
+			auto whole = length - (length % groupSize);
+			_kernel(pData, whole);
+			memcpy(_carry, pData + whole, length - whole);
+			_carried = length - whole;
+		}
+
+	private:
+		Kernel _kernel;
+		char _carry[groupSize];
+		size_t _carried;
+	};
+
+	template<size_t groupSize, typename Kernel>
+	void forEachGroup(const Buffer& buffer, size_t length, Kernel kernel)
+	{
+		GroupedRuns<groupSize, Kernel> groups(kernel);
+		buffer.forEachSegment(0, length, groups);
+	}
+
+	struct Output
+	{
+		Output(size_t length, IMemoryResource* pResource)
+			: block{ makeMemoryBlock<AlignedMemoryBlock>(pResource, length, 64, pResource) },
+			pNext{ block->getWritableMemory() }
+		{
+		}
+
+		std::shared_ptr<AlignedMemoryBlock> block;
+		char* pNext;
+	};
+
+	void invalidInput(const char* pMessage)
+	{
+		throw std::invalid_argument(pMessage);
+	}
+
+	// Hex
+
+	void encodeHexRun(const char* pIn, size_t length, char*& pOut)
+	{
+		size_t index = 0;
+#ifdef BUFFERLIB_SSE2
+		const auto lowNibble = _mm_set1_epi8(0x0F);
+		const auto nine = _mm_set1_epi8(9);
+		const auto zero = _mm_set1_epi8('0');
+		const auto letterOffset = _mm_set1_epi8('a' - '0' - 10);
+		for (; index + 16 <= length; index += 16)
+		{
+			auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn + index));
+			auto high = _mm_and_si128(_mm_srli_epi16(bytes, 4), lowNibble);
+			auto low = _mm_and_si128(bytes, lowNibble);
+			high = _mm_add_epi8(_mm_add_epi8(high, zero), _mm_and_si128(_mm_cmpgt_epi8(high, nine), letterOffset));
+			low = _mm_add_epi8(_mm_add_epi8(low, zero), _mm_and_si128(_mm_cmpgt_epi8(low, nine), letterOffset));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut), _mm_unpacklo_epi8(high, low));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + 16), _mm_unpackhi_epi8(high, low));
+			pOut += 32;
+		}
+#endif
+		for (; index < length; ++index)
+		{
+			auto byte = static_cast<unsigned char>(pIn[index]);
+			*pOut++ = kHexDigits[byte >> 4];
+			*pOut++ = kHexDigits[byte & 0x0F];
+		}
+	}
+
+	void decodeHexRun(const char* pIn, size_t length, char*& pOut)
+	{
+		size_t index = 0;
+#ifdef BUFFERLIB_SSE2
+		const auto ten = _mm_set1_epi8(10);
+		const auto six = _mm_set1_epi8(6);
+		const auto minusOne = _mm_set1_epi8(-1);
+		const auto lowerCase = _mm_set1_epi8(0x20);
+		const auto lowByte = _mm_set1_epi16(0x00FF);
+		for (; index + 32 <= length; index += 32)
+		{
+			__m128i values[2];
+			int valid = 0xFFFF;
+			for (int half = 0; half < 2; ++half)
+			{
+				auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn + index + half * 16));
+				auto digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+				auto isDigit = _mm_and_si128(_mm_cmpgt_epi8(digit, minusOne), _mm_cmplt_epi8(digit, ten));
+				auto letter = _mm_sub_epi8(_mm_or_si128(chars, lowerCase), _mm_set1_epi8('a'));
+				auto isLetter = _mm_and_si128(_mm_cmpgt_epi8(letter, minusOne), _mm_cmplt_epi8(letter, six));
+				valid &= _mm_movemask_epi8(_mm_or_si128(isDigit, isLetter));
+				auto nibbles = _mm_or_si128(_mm_and_si128(isDigit, digit), _mm_and_si128(isLetter, _mm_add_epi8(letter, ten)));
+				// Each 16 bit lane holds the high nibble then the low nibble
+				values[half] = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(nibbles, lowByte), 4), _mm_srli_epi16(nibbles, 8));
+			}
+			if (valid != 0xFFFF)
+			{
+				// Let the scalar loop report it
+				break;
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut), _mm_packus_epi16(values[0], values[1]));
+			pOut += 16;
+		}
+#endif
+		auto& tables = getDecodeTables();
+		for (; index < length; index += 2)
+		{
+			auto high = tables.hex[static_cast<unsigned char>(pIn[index])];
+			auto low = tables.hex[static_cast<unsigned char>(pIn[index + 1])];
+			if ((high == kInvalid) || (low == kInvalid))
+			{
+				invalidInput("Invalid hex digit");
+			}
+			*pOut++ = static_cast<char>((high << 4) | low);
+		}
+	}
+
+	// Base64
+
+#ifdef BUFFERLIB_SSSE3
+	// Twelve bytes from a sixteen byte load to sixteen characters.  After
+	// W. Mula and D. Lemire, "Faster Base64 Encoding and Decoding using AVX2 Instructions".
+	__m128i encodeBase64Block(__m128i bytes)
+	{
+		bytes = _mm_shuffle_epi8(bytes, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+		auto t0 = _mm_and_si128(bytes, _mm_set1_epi32(0x0fc0fc00));
+		auto t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+		auto t2 = _mm_and_si128(bytes, _mm_set1_epi32(0x003f03f0));
+		auto t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+		auto indices = _mm_or_si128(t1, t3);
+
+		// 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12, then the shift for each
+		auto reduced = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+		auto upperCase = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+		reduced = _mm_or_si128(reduced, _mm_and_si128(upperCase, _mm_set1_epi8(13)));
+		const auto shifts = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+		return _mm_add_epi8(_mm_shuffle_epi8(shifts, reduced), indices);
+	}
+
+	// Sixteen characters to twelve bytes, in the low 12 bytes of the result.
+	// Returns false if any character is outside the alphabet.
+	bool decodeBase64Block(__m128i chars, __m128i& bytes)
+	{
+		const auto lowLookup = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+			0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+		const auto highLookup = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+			0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+		const auto rollLookup = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+		const auto slash = _mm_set1_epi8(0x2F);
+
+		auto highNibbles = _mm_and_si128(_mm_srli_epi32(chars, 4), _mm_set1_epi8(0x0F));
+		auto lowNibbles = _mm_and_si128(chars, _mm_set1_epi8(0x0F));
+		auto high = _mm_shuffle_epi8(highLookup, highNibbles);
+		auto low = _mm_shuffle_epi8(lowLookup, lowNibbles);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(low, high), _mm_setzero_si128())) != 0xFFFF)
+		{
+			return false;
+		}
+		auto roll = _mm_shuffle_epi8(rollLookup, _mm_add_epi8(_mm_cmpeq_epi8(chars, slash), highNibbles));
+		auto values = _mm_add_epi8(chars, roll);
+
+		auto pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+		auto words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+		bytes = _mm_shuffle_epi8(words, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+		return true;
+	}
+#endif
+
+	void encodeBase64Group(const unsigned char* pIn, char* pOut)
+	{
+		pOut[0] = kBase64Alphabet[pIn[0] >> 2];
+		pOut[1] = kBase64Alphabet[((pIn[0] & 0x03) << 4) | (pIn[1] >> 4)];
+		pOut[2] = kBase64Alphabet[((pIn[1] & 0x0F) << 2) | (pIn[2] >> 6)];
+		pOut[3] = kBase64Alphabet[pIn[2] & 0x3F];
+	}
+
+	// length is a multiple of three
+	void encodeBase64Run(const char* pIn, size_t length, char*& pOut)
+	{
+		size_t index = 0;
+#ifdef BUFFERLIB_SSSE3
+		// Each load reads four bytes beyond the twelve it uses
+		for (; index + 16 <= length; index += 12)
+		{
+			auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn + index));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut), encodeBase64Block(bytes));
+			pOut += 16;
+		}
+#endif
+		for (; index < length; index += 3)
+		{
+			encodeBase64Group(reinterpret_cast<const unsigned char*>(pIn + index), pOut);
+			pOut += 4;
+		}
+	}
+
+	bool decodeBase64Group(const char* pIn, char* pOut)
+	{
+		auto& tables = getDecodeTables();
+		unsigned char values[4];
+		for (int index = 0; index < 4; ++index)
+		{
+			values[index] = tables.base64[static_cast<unsigned char>(pIn[index])];
+			if (values[index] == kInvalid)
+			{
+				return false;
+			}
+		}
+		pOut[0] = static_cast<char>((values[0] << 2) | (values[1] >> 4));
+		pOut[1] = static_cast<char>((values[1] << 4) | (values[2] >> 2));
+		pOut[2] = static_cast<char>((values[2] << 6) | values[3]);
+		return true;
+	}
+
+	// length is a multiple of four, with no padding
+	void decodeBase64Run(const char* pIn, size_t length, char*& pOut)
+	{
+		size_t index = 0;
+#ifdef BUFFERLIB_SSSE3
+		// Each store writes four bytes beyond the twelve decoded, so stop
+		// while there's room for them in what the rest of the run will decode
+		for (; index + 24 <= length; index += 16)
+		{
+			__m128i bytes;
+			if (!decodeBase64Block(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn + index)), bytes))
+			{
+				// Let the scalar loop report it
+				break;
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut), bytes);
+			pOut += 12;
+		}
+#endif
+		for (; index < length; index += 4)
+		{
+			if (!decodeBase64Group(pIn + index, pOut))
+			{
+				invalidInput("Invalid base64 character");
+			}
+			pOut += 3;
+		}
+	}
+}
+
+Buffer encodeHex(const Buffer & buffer, IMemoryResource * pResource)
+{
+	auto length = buffer.getLength();
+	if (length == 0)
+	{
+		return Buffer{ pResource };
+	}
+	Output output(length * 2, pResource);
+	buffer.forEachSegment(0, length, [&output](const char* pData, size_t runLength) { encodeHexRun(pData, runLength, output.pNext); });
+	return Buffer{ output.block, pResource };
+}
+
+Buffer decodeHex(const Buffer & buffer, IMemoryResource * pResource)
+{
+	auto length = buffer.getLength();
+	if ((length % 2) != 0)
+	{
+		invalidInput("Hex input has an odd length");
+	}
+	if (length == 0)
+	{
+		return Buffer{ pResource };
+	}
+	Output output(length / 2, pResource);
+	forEachGroup<2>(buffer, length, [&output](const char* pData, size_t runLength) { decodeHexRun(pData, runLength, output.pNext); });
+	return Buffer{ output.block, pResource };
+}
+
+Buffer encodeBase64(const Buffer & buffer, IMemoryResource * pResource)
+{
+	auto length = buffer.getLength();
+	if (length == 0)
+	{
+		return Buffer{ pResource };
+	}
+	Output output(((length + 2) / 3) * 4, pResource);
+	auto whole = length - (length % 3);
+	forEachGroup<3>(buffer, whole, [&output](const char* pData, size_t runLength) { encodeBase64Run(pData, runLength, output.pNext); });
+
+	// Pad out the last partial group
+	if (whole < length)
+	{
+		unsigned char last[3] = { 0, 0, 0 };
+		buffer.copy(whole, length - whole, reinterpret_cast<char*>(last));
+		encodeBase64Group(last, output.pNext);
+		output.pNext[3] = '=';
+		if (length - whole == 1)
+		{
+			output.pNext[2] = '=';
+		}
+	}
+	return Buffer{ output.block, pResource };
+}
+
+Buffer decodeBase64(const Buffer & buffer, IMemoryResource * pResource)
+{
+	auto length = buffer.getLength();
+	if (length == 0)
+	{
+		return Buffer{ pResource };
+	}
+
+	// Set aside the last group, which may be padded or short
+	auto lastLength = (length % 4 == 0) ? 4 : length % 4;
+	if (lastLength == 1)
+	{
+		invalidInput("Base64 input has an impossible length");
+	}
+	char last[4] = { 'A', 'A', 'A', 'A' };
+	buffer.copy(length - lastLength, lastLength, last);
+	auto lastBytes = lastLength - 1;
+	if ((lastLength == 4) && (last[3] == '='))
+	{
+		lastBytes = (last[2] == '=') ? 1 : 2;
+		last[3] = 'A';
+		if (last[2] == '=')
+		{
+			last[2] = 'A';
+		}
+	}
+
+	Output output((length - lastLength) / 4 * 3 + lastBytes, pResource);
+	forEachGroup<4>(buffer, length - lastLength, [&output](const char* pData, size_t runLength) { decodeBase64Run(pData, runLength, output.pNext); });
+
+	char lastDecoded[3];
+	if (!decodeBase64Group(last, lastDecoded))
+	{
+		invalidInput("Invalid base64 character");
+	}
+	// Padding decodes to zero, so anything left over came from unused trailing bits
+	for (auto index = lastBytes; index < 3; ++index)
+	{
+		if (lastDecoded[index] != 0)
+		{
+			invalidInput("Base64 input has non-zero trailing bits");
+		}
+	}
+	memcpy(output.pNext, lastDecoded, lastBytes);
+	return Buffer{ output.block, pResource };
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Buffer.h"
+#include "MemoryResource.h"
+
+	// Hex and base64 (RFC 4648, standard alphabet) conversion between Buffers.
+	// The input is read a fragment at a time without flattening, groups of
+	// characters that straddle fragments included.  Each result is a new Buffer
+	// of one block, allocated from pResource.  Bulk conversion uses SSE2, and
+	// SSSE3 for base64, where the compiler targets them.
+
+	// Lower case hex digits
+	Buffer encodeHex(const Buffer& buffer, IMemoryResource* pResource = getDefaultMemoryResource());
+	// Accepts either case.  Throws std::invalid_argument for anything else, or an odd length.
+	Buffer decodeHex(const Buffer& buffer, IMemoryResource* pResource = getDefaultMemoryResource());
+
+	// Padded with '='
+	Buffer encodeBase64(const Buffer& buffer, IMemoryResource* pResource = getDefaultMemoryResource());
+	// Padding is optional.  Throws std::invalid_argument for characters outside
+	// the alphabet (including whitespace), an impossible length, or a last
+	// character with non-zero bits beyond the end of the data ("Zh==").
+	Buffer decodeBase64(const Buffer& buffer, IMemoryResource* pResource = getDefaultMemoryResource());
@@ -0,0 +1,265 @@
+#include "BufferFile.h"
+#include "IMemoryBlock.h"
+#include "MappedFileBlock.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const char kMagic[8] = { 'B', 'U', 'F', 'F', 'E', 'R', 'L', 'B' };
+	const uint32_t kVersion = 1;
+
+	// All fields are fixed width, in the byte order of the machine writing them
+	struct FileHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t payloadAlignment;
+		uint64_t blockCount;
+		uint64_t extentCount;
+		uint64_t totalLength;
+	};
+
+	struct BlockEntry
+	{
+		uint64_t fileOffset;
+		uint64_t length;
+	};
+
+	struct ExtentEntry
+	{
+		uint64_t blockIndex;
+		// Relative to the start of the stored block
+		uint64_t offset;
+		uint64_t length;
+	};
+
+	// Part of a memory block in use, from start up to end
+	struct Interval
+	{
+		size_t start;
+		size_t end;
+		// Offset of start in the stored bytes
+		size_t storedStart;
+	};
+
+	// The parts of a memory block used by the buffer being saved.  They're
+	// stored back to back, so gaps between them take no space in the file.
+	struct BlockRange
+	{
+		const IMemoryBlock* pMemoryBlock;
+		// Bytes to store instead of a block's, for the inline fragments
+		const char* pData;
+		// Sorted and merged once every fragment has been seen
+		std::vector<Interval> intervals;
+		size_t storedLength;
+	};
+
+	uint64_t alignUp(uint64_t value)
+	{
+		return ((value + kBufferFilePayloadAlignment - 1) / kBufferFilePayloadAlignment) * kBufferFilePayloadAlignment;
+	}
+
+	// Sort and merge a range's intervals, and total their length
+	void mergeIntervals(BlockRange& range)
+	{
+		auto& intervals = range.intervals;
+		std::sort(intervals.begin(), intervals.end(), [](const Interval& lhs, const Interval& rhs) { return lhs.start < rhs.start; });
+		size_t merged = 0;
+		for (size_t index = 1; index < intervals.size(); ++index)
+		{
+			if (intervals[index].start <= intervals[merged].end)
+			{
+				intervals[merged].end = std::max(intervals[merged].end, intervals[index].end);
+			}
+			else
+			{
+				intervals[++merged] = intervals[index];
+			}
+		}
+		intervals.resize(intervals.empty() ? 0 : merged + 1);
+		range.storedLength = 0;
+		for (auto& interval : intervals)
+		{
+			interval.storedStart = range.storedLength;
+			range.storedLength += interval.end - interval.start;
+		}
+	}
+
+	// Where a block offset ends up in the range's stored bytes
+	size_t getStoredOffset(const BlockRange& range, size_t offset)
+	{
+		// Last interval starting at or before offset, which is the one containing it
+		auto found = std::upper_bound(range.intervals.cbegin(), range.intervals.cend(), offset,
+			[](size_t value, const Interval& interval) { return value < interval.start; }) - 1;
+		return found->storedStart + offset - found->start;
+	}
+
+	void writeInterval(std::ofstream& file, const BlockRange& range, const Interval& interval)
+	{
+		auto pMemory = (range.pData != nullptr) ? range.pData : range.pMemoryBlock->getMemory();
+		if (pMemory != nullptr)
+		{
+			file.write(pMemory + interval.start, interval.end - interval.start);
+			return;
+		}
+		// No direct access to the memory, so copy it out a piece at a time
+		std::vector<char> chunk(64 * 1024);
+		for (auto offset = interval.start; offset < interval.end; )
+		{
+			auto length = (interval.end - offset < chunk.size()) ? interval.end - offset : chunk.size();
+			auto copied = range.pMemoryBlock->copy(offset, length, chunk.data());
+			file.write(chunk.data(), copied);
+			if (copied == 0)
+			{
+				break;
+			}
+			offset += copied;
+		}
+	}
+}
+
+void saveBuffer(const Buffer & buffer, const std::string & path)
+{
+	auto& fragments = buffer.getFragments();
+
+	// Give each distinct memory block an index, and collect the parts of it in use
+	std::map<const IMemoryBlock*, size_t> blockIndices;
+	std::vector<BlockRange> ranges;
+	std::vector<ExtentEntry> extents;
+	extents.reserve(fragments.size());
+	// Inline fragments have no block, so their bytes are stored together as one
+	std::string inlineBytes;
+	auto inlineIndex = SIZE_MAX;
+	for (auto& fragment : fragments)
+	{
+		if (fragment.isInline())
+		{
+			if (inlineIndex == SIZE_MAX)
+			{
+				inlineIndex = ranges.size();
+				ranges.push_back(BlockRange{ nullptr, nullptr, {}, 0 });
+			}
+			extents.push_back(ExtentEntry{ inlineIndex, inlineBytes.size(), fragment.getLength() });
+			inlineBytes.append(fragment.getMemory(), fragment.getLength());
+			continue;
+		}
+		auto pMemoryBlock = fragment.getMemoryBlock().get();
+		auto start = fragment.getOffset();
+		auto found = blockIndices.find(pMemoryBlock);
+		if (found == blockIndices.end())
+		{
+			found = blockIndices.emplace(pMemoryBlock, ranges.size()).first;
+			ranges.push_back(BlockRange{ pMemoryBlock, nullptr, {}, 0 });
+		}
+		ranges[found->second].intervals.push_back(Interval{ start, start + fragment.getLength(), 0 });
+		extents.push_back(ExtentEntry{ found->second, start, fragment.getLength() });
+	}
+	if (inlineIndex != SIZE_MAX)
+	{
+		ranges[inlineIndex].pData = inlineBytes.data();
+		ranges[inlineIndex].intervals.push_back(Interval{ 0, inlineBytes.size(), 0 });
+	}
+
+	std::vector<BlockEntry> blocks;
+	blocks.reserve(ranges.size());
+	uint64_t fileOffset = alignUp(sizeof(FileHeader) + ranges.size() * sizeof(BlockEntry) + extents.size() * sizeof(ExtentEntry));
+	for (auto& range : ranges)
+	{
+		mergeIntervals(range);
+		blocks.push_back(BlockEntry{ fileOffset, range.storedLength });
+		fileOffset = alignUp(fileOffset + range.storedLength);
+	}
+	for (auto& extent : extents)
+	{
+		extent.offset = getStoredOffset(ranges[extent.blockIndex], static_cast<size_t>(extent.offset));
+	}
+
+	FileHeader header;
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.payloadAlignment = kBufferFilePayloadAlignment;
+	header.blockCount = blocks.size();
+	header.extentCount = extents.size();
+	header.totalLength = buffer.getLength();
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		throw std::runtime_error("Cannot create " + path);
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(blocks.data()), blocks.size() * sizeof(BlockEntry));
+	file.write(reinterpret_cast<const char*>(extents.data()), extents.size() * sizeof(ExtentEntry));
+
+	const std::vector<char> padding(kBufferFilePayloadAlignment, 0);
+	for (size_t index = 0; index < blocks.size(); ++index)
+	{
+		auto position = static_cast<uint64_t>(file.tellp());
+		file.write(padding.data(), blocks[index].fileOffset - position);
+		for (auto& interval : ranges[index].intervals)
+		{
+			writeInterval(file, ranges[index], interval);
+		}
+	}
+	file.close();
+	if (!file)
+	{
+		throw std::runtime_error("Cannot write " + path);
+	}
+}
+
+Buffer loadBuffer(const std::string & path)
+{
+	auto pMapping = std::make_shared<MappedFileBlock>(path);
+	auto fileLength = static_cast<uint64_t>(pMapping->getLength());
+
+	FileHeader header;
+	if (pMapping->copy(0, sizeof(header), reinterpret_cast<char*>(&header)) != sizeof(header) ||
+		(memcmp(header.magic, kMagic, sizeof(kMagic)) != 0))
+	{
+		throw std::runtime_error(path + " is not a Buffer file");
+	}
+	if (header.version != kVersion)
+	{
+		throw std::runtime_error(path + " has unsupported Buffer file version " + std::to_string(header.version));
+	}
+	auto tablesLength = header.blockCount * sizeof(BlockEntry) + header.extentCount * sizeof(ExtentEntry);
+	if ((header.blockCount > fileLength) || (header.extentCount > fileLength) || (sizeof(header) + tablesLength > fileLength))
+	{
+		throw std::runtime_error(path + " is truncated");
+	}
+
+	std::vector<BlockEntry> blocks(static_cast<size_t>(header.blockCount));
+	std::vector<ExtentEntry> extents(static_cast<size_t>(header.extentCount));
+	pMapping->copy(sizeof(header), blocks.size() * sizeof(BlockEntry), reinterpret_cast<char*>(blocks.data()));
+	pMapping->copy(sizeof(header) + blocks.size() * sizeof(BlockEntry), extents.size() * sizeof(ExtentEntry), reinterpret_cast<char*>(extents.data()));
+
+	Buffer result;
+	result.reserve(extents.size());
+	for (auto& extent : extents)
+	{
+		// The entries come from the file, so compare without sums that could overflow
+		if ((extent.blockIndex >= blocks.size()) ||
+			(extent.offset > blocks[extent.blockIndex].length) ||
+			(extent.length > blocks[extent.blockIndex].length - extent.offset) ||
+			(blocks[extent.blockIndex].length > fileLength) ||
+			(blocks[extent.blockIndex].fileOffset > fileLength - blocks[extent.blockIndex].length))
+		{
+			throw std::runtime_error(path + " has an extent outside its payload");
+		}
+		result.append(pMapping, static_cast<size_t>(blocks[extent.blockIndex].fileOffset + extent.offset), static_cast<size_t>(extent.length));
+	}
+	if (result.getLength() != header.totalLength)
+	{
+		throw std::runtime_error(path + " has inconsistent length");
+	}
+	return result;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include "Buffer.h"
+
+	// Persist a Buffer in a versioned container file, and reload it without
+	// reading the payload.  The file holds a header, a table of stored blocks,
+	// a table of extents (one per fragment) and then the block payloads, each
+	// aligned to kBufferFilePayloadAlignment.  A memory block shared by several
+	// fragments is stored once, holding only the bytes they use: overlapping
+	// parts are stored once and gaps between them aren't stored at all.
+	const size_t kBufferFilePayloadAlignment = 4096;
+
+	void saveBuffer(const Buffer& buffer, const std::string& path);
+	// The returned Buffer's fragments point straight into a read-only mapping
+	// of the file, so pages are only read as they are accessed.
+	Buffer loadBuffer(const std::string& path);
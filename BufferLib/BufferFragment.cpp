@@ -2,38 +2,67 @@
 
 //using namespace BufferLib;
 
-#include "IMemoryBlock.h"
+#include <cstring>
+#include <new>
 
 BufferFragment::BufferFragment(std::shared_ptr<IMemoryBlock> pMemoryBlock, size_t offset, size_t length) :
-	_memoryBlock{pMemoryBlock},
-	_offset{ getInitialOffset(pMemoryBlock, offset) },
-	_length{ getInitialLength(pMemoryBlock, offset, length) }
+	_reference{ pMemoryBlock, getInitialOffset(pMemoryBlock, offset) },
+	_length{ getInitialLength(pMemoryBlock, offset, length) },
+	_pData{ pMemoryBlock->getMemory() }
 {
+	if (_pData != nullptr)
+	{
+		_pData += _reference.offset;
+	}
 }
 
-BufferFragment::BufferFragment(BufferFragment && source) :
-	_memoryBlock{source._memoryBlock},
-	_offset{source._offset},
-	_length{source._length}
+BufferFragment::BufferFragment(BufferFragment && source) noexcept
 {
+	takeFrom(source);
 }
 
+BufferFragment::BufferFragment(const BufferFragment & source) :
+	_length{ source._length },
+	_pData{ source._pData }
+{
+	if (source.isInline())
+	{
+		memcpy(_inlineData, source._inlineData, _length);
+		_pData = _inlineData;
+	}
+	else
+	{
+		new (&_reference) BlockReference(source._reference);
+	}
+}
 
-BufferFragment::BufferFragment(const BufferFragment & source, size_t offset, size_t length) :
-	_memoryBlock{source._memoryBlock},
-	_offset{ offset + source._offset },
-	_length{ length }
+BufferFragment::BufferFragment(const BufferFragment & source, size_t offset, size_t length, SliceMode mode) :
+	_length{ length },
+	_pData{ nullptr }
 {
 	// Check offset is within the source fragment
-	if (_offset > (source._offset + source._length))
+	if (offset > source._length)
 	{
-		_offset = source._offset;
+		offset = 0;
 		_length = 0;
 	}
-	else if ((_offset + _length) > (source._offset + source._length))
+	else if (_length > (source._length - offset))
 	{
 		// Length extends beyond source fragment
-		_length = source._offset + source._length - _offset;
+		_length = source._length - offset;
+	}
+
+	if (source.isInline() || ((mode == SliceMode::Inline) && (_length <= kInlineCapacity)))
+	{
+		// Keep the bytes rather than a reference to the block
+		source.copy(offset, _length, _inlineData);
+		_pData = _inlineData;
+		return;
+	}
+	new (&_reference) BlockReference{ source._reference.block, source._reference.offset + offset };
+	if (source._pData != nullptr)
+	{
+		_pData = source._pData + offset;
 	}
 }
 
@@ -43,56 +72,63 @@ BufferFragment BufferFragment::operator=(const BufferFragment & source)
 	{
 		return *this;
 	}
-	_memoryBlock = source._memoryBlock;
-	_offset = source._offset;
-	_length = source._length;
+	// Copy first, as source may be kept alive by this fragment's block
+	BufferFragment copied{ source };
+	destroy();
+	takeFrom(copied);
 
 	return *this;
 }
 
-BufferFragment BufferFragment::operator=(BufferFragment && source)
+BufferFragment BufferFragment::operator=(BufferFragment && source) noexcept
 {
-	_memoryBlock.swap(source._memoryBlock);
-	_offset = source._offset;
-	_length = source._length;
-	source._offset = source._length = 0;
+	if (this != &source)
+	{
+		destroy();
+		takeFrom(source);
+	}
 	return *this;
 }
 
 BufferFragment::~BufferFragment()
 {
+	destroy();
 }
 
-size_t BufferFragment::getLength() const
+std::shared_ptr<IMemoryBlock> BufferFragment::getMemoryBlock() const
 {
-	return _length;
+	return isInline() ? nullptr : _reference.block;
 }
 
-const char & BufferFragment::operator[](size_t offset) const
+size_t BufferFragment::getOffset() const
 {
-	return (*_memoryBlock)[offset + _offset];
-	// TODO: access out of range
+	return isInline() ? 0 : _reference.offset;
 }
 
 size_t BufferFragment::copy(size_t offset, size_t length, char * pDestination) const
 {
-	auto srcOffset{ offset + _offset };
+	auto srcOffset{ offset + getOffset() };
 	auto maxLength{ _length - offset };
 	auto copyLength{ length > maxLength ? maxLength : length };
-	
-	return _memoryBlock->copy(srcOffset, copyLength , pDestination);
+
+	if (_pData != nullptr)
+	{
+		memcpy(pDestination, _pData + offset, copyLength);
+		return copyLength;
+	}
+	return _reference.block->copy(srcOffset, copyLength , pDestination);
 }
 
 std::string BufferFragment::asString() const
 {
 	std::string result("Fragment:\"");
 
-	char* pTempStr = new char[getLength() + 1];
-	pTempStr[getLength()] = 0;
-	copy(0, getLength(), pTempStr);
-
-	std::string contents(pTempStr);
-	delete[] pTempStr;
+	// Copied by length, so embedded nulls are kept
+	std::string contents(getLength(), '\0');
+	if (!contents.empty())
+	{
+		copy(0, getLength(), &contents[0]);
+	}
 	result += contents;
 
 	result += "\"";
@@ -125,3 +161,30 @@ size_t BufferFragment::getInitialLength(std::shared_ptr<IMemoryBlock> xpMemoryBl
 	}
 	return length;
 }
+
+void BufferFragment::takeFrom(BufferFragment & source)
+{
+	_length = source._length;
+	if (source.isInline())
+	{
+		memcpy(_inlineData, source._inlineData, _length);
+		_pData = _inlineData;
+	}
+	else
+	{
+		new (&_reference) BlockReference(std::move(source._reference));
+		_pData = source._pData;
+		source.destroy();
+		// Leave the source as an empty inline fragment
+		source._pData = source._inlineData;
+	}
+	source._length = 0;
+}
+
+void BufferFragment::destroy()
+{
+	if (!isInline())
+	{
+		_reference.~BlockReference();
+	}
+}
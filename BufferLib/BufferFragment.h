@@ -2,32 +2,105 @@
 
 #include <memory>
 #include <string>
+#include "IMemoryBlock.h"
 
-class IMemoryBlock;
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
 
 
+	// Part of a memory block, or, when asked for, a copy of up to kInlineCapacity
+	// bytes held in the fragment itself.  Inline fragments have no block, so small
+	// slices don't keep large blocks alive, but being copies they don't see later
+	// writes to the block they were cut from.
 	class BufferFragment
 	{
 	public:
+		// How a part cut from a fragment holds its bytes.  Inline copies parts of
+		// up to kInlineCapacity bytes and refers to the block for longer ones.
+		enum class SliceMode { Reference, Inline };
+
 		BufferFragment(std::shared_ptr<IMemoryBlock> pMemoryBlock, size_t offset, size_t length);
-		BufferFragment(BufferFragment&& source);
-		BufferFragment(const BufferFragment& source) : BufferFragment{ source, 0, source.getLength() } {}
-		BufferFragment(const BufferFragment& source, size_t offset, size_t length);
+		BufferFragment(BufferFragment&& source) noexcept;
+		// Copies keep the source's form, so a copied fragment refers to the same block
+		BufferFragment(const BufferFragment& source);
+		BufferFragment(const BufferFragment& source, size_t offset, size_t length, SliceMode mode = SliceMode::Reference);
 		BufferFragment operator=(const BufferFragment& source);
-		BufferFragment operator=(BufferFragment&& source);
+		BufferFragment operator=(BufferFragment&& source) noexcept;
 		virtual ~BufferFragment();
 
-		size_t getLength() const;
-		const char& operator[](size_t offset) const;
+		size_t getLength() const { return _length; }
+		bool isInline() const { return _pData == _inlineData; }
+		// Memory block the fragment refers to, and where in that block it starts.
+		// Inline fragments have no block (nullptr) and start at 0.
+		std::shared_ptr<IMemoryBlock> getMemoryBlock() const;
+		size_t getOffset() const;
+		// Start of the fragment's memory, or nullptr if the block has no direct access
+		const char* getMemory() const { return _pData; }
+		const char& operator[](size_t offset) const
+		{
+			// TODO: access out of range
+			// Read the memory directly where possible, so byte access is inlined
+			// rather than a virtual call into the memory block
+			return (_pData != nullptr) ? _pData[offset] : (*_reference.block)[offset + _reference.offset];
+		}
 		size_t copy(size_t offset, size_t length, char* pDestination) const;
 		std::string asString() const;
+		// Hint that the start of the fragment will be read soon.  Sequential access
+		// calls this for the next fragment, so its first cache lines are loaded by
+		// the time it's reached.  Does nothing for blocks without direct access.
+		void prefetch() const
+		{
+			if (_pData != nullptr)
+			{
+				prefetchLine(_pData);
+				if (_length > kCacheLineLength)
+				{
+					prefetchLine(_pData + kCacheLineLength);
+				}
+			}
+		}
 	private:
+		struct BlockReference
+		{
+			std::shared_ptr<IMemoryBlock> block;
+			size_t offset;
+		};
+
+	public:
+		// Longest fragment stored inline, in the space a block reference takes
+		static const size_t kInlineCapacity = sizeof(BlockReference);
+
+	private:
+		static const size_t kCacheLineLength = 64;
+
+		static void prefetchLine(const char* pAddress)
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			__builtin_prefetch(pAddress);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+			_mm_prefetch(pAddress, _MM_HINT_T0);
+#else
+			(void)pAddress;
+#endif
+		}
+
 		size_t getInitialOffset(std::shared_ptr<IMemoryBlock> pMemoryBlock, size_t offset);
 		size_t getInitialLength(std::shared_ptr<IMemoryBlock> pMemoryBlock, size_t offset, size_t length);
+		// Set up the union from source, which is left empty.  Only for raw storage.
+		void takeFrom(BufferFragment& source);
+		void destroy();
 
-		std::shared_ptr<IMemoryBlock> _memoryBlock;
-		size_t _offset;
+		// Which member is in use is given by whether _pData points at _inlineData
+		union
+		{
+			BlockReference _reference;
+			char _inlineData[kInlineCapacity];
+		};
 		size_t _length;
+		// Cached from the memory block's getMemory(), offset to the start of the
+		// fragment, or _inlineData.  Fixed up whenever a fragment is copied or moved.
+		const char* _pData;
 	};
 
 
@@ -0,0 +1,134 @@
+#include "BufferMatcher.h"
+
+#include <deque>
+
+BufferMatcher::BufferMatcher(const std::vector<std::string>& patterns)
+	: _classCount{ 1 }
+{
+	for (auto& classIndex : _byteClass)
+	{
+		classIndex = 0;
+	}
+	for (auto& pattern : patterns)
+	{
+		_patternLengths.push_back(pattern.size());
+		for (auto c : pattern)
+		{
+			auto& classIndex = _byteClass[static_cast<unsigned char>(c)];
+			if (classIndex == 0)
+			{
+				classIndex = static_cast<uint16_t>(_classCount++);
+			}
+		}
+	}
+
+	// Build the trie.  Zero marks a missing edge, as nothing links back to the root.
+	std::vector<std::vector<uint32_t>> outputs(1);
+	_transitions.assign(_classCount, 0);
+	for (size_t patternIndex = 0; patternIndex < patterns.size(); ++patternIndex)
+	{
+		if (patterns[patternIndex].empty())
+		{
+			continue;
+		}
+		uint32_t node = 0;
+		for (auto c : patterns[patternIndex])
+		{
+			auto& edge = _transitions[node * _classCount + _byteClass[static_cast<unsigned char>(c)]];
+			if (edge == 0)
+			{
+				edge = static_cast<uint32_t>(outputs.size());
+				outputs.emplace_back();
+				_transitions.resize(_transitions.size() + _classCount, 0);
+			}
+			node = _transitions[node * _classCount + _byteClass[static_cast<unsigned char>(c)]];
+		}
+		outputs[node].push_back(static_cast<uint32_t>(patternIndex));
+	}
+
+	// Breadth first, turn missing edges into the failure node's transition,
+	// giving a complete automaton with no failure links to follow while scanning
+	std::vector<uint32_t> failure(outputs.size(), 0);
+	std::deque<uint32_t> pending;
+	for (size_t classIndex = 0; classIndex < _classCount; ++classIndex)
+	{
+		auto child = _transitions[classIndex];
+		if (child != 0)
+		{
+			pending.push_back(child);
+		}
+	}
+	while (!pending.empty())
+	{
+		auto node = pending.front();
+		pending.pop_front();
+		auto& nodeOutputs = outputs[node];
+		auto& failureOutputs = outputs[failure[node]];
+		nodeOutputs.insert(nodeOutputs.end(), failureOutputs.begin(), failureOutputs.end());
+
+		for (size_t classIndex = 0; classIndex < _classCount; ++classIndex)
+		{
+			auto& edge = _transitions[node * _classCount + classIndex];
+			auto failureNext = _transitions[failure[node] * _classCount + classIndex];
+			if (edge == 0)
+			{
+				edge = failureNext;
+			}
+			else
+			{
+				failure[edge] = failureNext;
+				pending.push_back(edge);
+			}
+		}
+	}
+
+	_outputStart.reserve(outputs.size() + 1);
+	for (auto& nodeOutputs : outputs)
+	{
+		_outputStart.push_back(static_cast<uint32_t>(_outputs.size()));
+		_outputs.insert(_outputs.end(), nodeOutputs.begin(), nodeOutputs.end());
+	}
+	_outputStart.push_back(static_cast<uint32_t>(_outputs.size()));
+}
+
+void BufferMatcher::scan(const Buffer & buffer, State & state, const std::function<void(const Match&)>& onMatch) const
+{
+	buffer.forEachSegment(0, buffer.getLength(), [&](const char* pData, size_t length) {
+		state._node = scanBlock(pData, length, state._node, state._streamOffset, onMatch);
+		state._streamOffset += length;
+	});
+}
+
+std::vector<BufferMatcher::Match> BufferMatcher::findAll(const Buffer & buffer) const
+{
+	std::vector<Match> matches;
+	State state;
+	scan(buffer, state, [&matches](const Match& match) { matches.push_back(match); });
+	return matches;
+}
+
+size_t BufferMatcher::getPatternCount() const
+{
+	return _patternLengths.size();
+}
+
+uint32_t BufferMatcher::scanBlock(const char * pData, size_t length, uint32_t node, size_t streamOffset, const std::function<void(const Match&)>& onMatch) const
+{
+	auto pTransitions = _transitions.data();
+	auto pOutputStart = _outputStart.data();
+	auto classCount = _classCount;
+	for (size_t index = 0; index < length; ++index)
+	{
+		node = pTransitions[node * classCount + _byteClass[static_cast<unsigned char>(pData[index])]];
+		if (pOutputStart[node] != pOutputStart[node + 1])
+		{
+			auto end = streamOffset + index + 1;
+			for (auto output = pOutputStart[node]; output < pOutputStart[node + 1]; ++output)
+			{
+				auto patternIndex = _outputs[output];
+				onMatch(Match{ patternIndex, end - _patternLengths[patternIndex], _patternLengths[patternIndex] });
+			}
+		}
+	}
+	return node;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Buffer.h"
+
+	// Finds every occurrence of a set of patterns in one pass (Aho-Corasick).
+	// The automaton is compiled once into a dense transition table indexed by
+	// byte class, so scanning is one table lookup per byte.  Buffers are scanned
+	// a fragment at a time without flattening, and a State carries partial
+	// matches over from one Buffer to the next.
+	class BufferMatcher
+	{
+	public:
+		struct Match
+		{
+			size_t patternIndex;
+			// Start of the match, counted from the start of the stream.  For a
+			// single Buffer, the match is at buffer.cbegin() + offset.
+			size_t offset;
+			size_t length;
+		};
+
+		// Progress through a stream of Buffers
+		class State
+		{
+		public:
+			State() : _node{ 0 }, _streamOffset{ 0 } {}
+			// Bytes scanned so far
+			size_t getStreamOffset() const { return _streamOffset; }
+		private:
+			friend class BufferMatcher;
+			uint32_t _node;
+			size_t _streamOffset;
+		};
+
+		// Empty patterns never match
+		explicit BufferMatcher(const std::vector<std::string>& patterns);
+
+		// Scan the next Buffer in a stream, reporting each match as its last byte is reached
+		void scan(const Buffer& buffer, State& state, const std::function<void(const Match&)>& onMatch) const;
+		// All matches within a single Buffer, in order of where they end
+		std::vector<Match> findAll(const Buffer& buffer) const;
+
+		size_t getPatternCount() const;
+	private:
+		uint32_t scanBlock(const char* pData, size_t length, uint32_t node, size_t streamOffset, const std::function<void(const Match&)>& onMatch) const;
+
+		std::vector<size_t> _patternLengths;
+		// Bytes that appear in no pattern share class 0
+		uint16_t _byteClass[256];
+		size_t _classCount;
+		// _transitions[node * _classCount + class] is the next node
+		std::vector<uint32_t> _transitions;
+		// Patterns ending at node n are _outputs[_outputStart[n]] to _outputs[_outputStart[n + 1] - 1]
+		std::vector<uint32_t> _outputStart;
+		std::vector<uint32_t> _outputs;
+	};
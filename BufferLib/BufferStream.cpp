@@ -0,0 +1,373 @@
+#include "BufferStream.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+
+BufferStream::Poll BufferStream::tryNext(Buffer & buffer)
+{
+	return next(buffer) ? Poll::Ready : Poll::Done;
+}
+
+BufferStream::Poll BufferStream::pull(BufferStream & source, Buffer & buffer, bool wait)
+{
+	if (wait)
+	{
+		return source.next(buffer) ? Poll::Ready : Poll::Done;
+	}
+	return source.tryNext(buffer);
+}
+
+
+MapStream::MapStream(std::shared_ptr<BufferStream> pSource, std::function<Buffer(Buffer)> transform)
+	: _source{ pSource },
+	_transform{ transform }
+{
+}
+
+bool MapStream::next(Buffer & buffer)
+{
+	return poll(buffer, true) == Poll::Ready;
+}
+
+BufferStream::Poll MapStream::tryNext(Buffer & buffer)
+{
+	return poll(buffer, false);
+}
+
+BufferStream::Poll MapStream::poll(Buffer & buffer, bool wait)
+{
+	Buffer input;
+	auto result = pull(*_source, input, wait);
+	if (result == Poll::Ready)
+	{
+		buffer = _transform(std::move(input));
+	}
+	return result;
+}
+
+
+SplitStream::SplitStream(std::shared_ptr<BufferStream> pSource, char delimiter)
+	: _source{ pSource },
+	_delimiter{ delimiter },
+	_searchedFragments{ 0 },
+	_searchedLength{ 0 },
+	_sourceDone{ false }
+{
+}
+
+bool SplitStream::next(Buffer & buffer)
+{
+	return poll(buffer, true) == Poll::Ready;
+}
+
+BufferStream::Poll SplitStream::tryNext(Buffer & buffer)
+{
+	return poll(buffer, false);
+}
+
+BufferStream::Poll SplitStream::poll(Buffer & buffer, bool wait)
+{
+	for (;;)
+	{
+		auto& fragments = _pending.getFragments();
+		for (; _searchedFragments < fragments.size(); ++_searchedFragments)
+		{
+			auto found = findInFragment(_searchedFragments);
+			if (found != std::string::npos)
+			{
+				auto offset = _searchedLength + found;
+				buffer = _pending.slice(0, offset);
+				_pending = _pending.subspan(offset + 1);
+				_searchedFragments = 0;
+				_searchedLength = 0;
+				return Poll::Ready;
+			}
+			_searchedLength += fragments[_searchedFragments].getLength();
+		}
+
+		Buffer input;
+		auto result = _sourceDone ? Poll::Done : pull(*_source, input, wait);
+		if (result == Poll::Pending)
+		{
+			return result;
+		}
+		if (result == Poll::Done)
+		{
+			_sourceDone = true;
+			if (_pending.getLength() == 0)
+			{
+				return Poll::Done;
+			}
+			// Trailing record without a delimiter
+			buffer = std::move(_pending);
+			_pending = Buffer{};
+			_searchedFragments = 0;
+			_searchedLength = 0;
+			return Poll::Ready;
+		}
+		_pending += input;
+	}
+}
+
+size_t SplitStream::findInFragment(size_t index) const
+{
+	auto& fragment = _pending.getFragments()[index];
+	auto pMemory = fragment.getMemory();
+	if (pMemory != nullptr)
+	{
+		auto pFound = static_cast<const char*>(memchr(pMemory, _delimiter, fragment.getLength()));
+		return (pFound == nullptr) ? std::string::npos : static_cast<size_t>(pFound - pMemory);
+	}
+	for (size_t offset = 0; offset < fragment.getLength(); ++offset)
+	{
+		if (fragment[offset] == _delimiter)
+		{
+			return offset;
+		}
+	}
+	return std::string::npos;
+}
+
+
+ConcatenateStream::ConcatenateStream(std::vector<std::shared_ptr<BufferStream>> sources)
+	: _sources{ sources },
+	_current{ 0 }
+{
+}
+
+bool ConcatenateStream::next(Buffer & buffer)
+{
+	return poll(buffer, true) == Poll::Ready;
+}
+
+BufferStream::Poll ConcatenateStream::tryNext(Buffer & buffer)
+{
+	return poll(buffer, false);
+}
+
+BufferStream::Poll ConcatenateStream::poll(Buffer & buffer, bool wait)
+{
+	while (_current < _sources.size())
+	{
+		auto result = pull(*_sources[_current], buffer, wait);
+		if (result != Poll::Done)
+		{
+			return result;
+		}
+		++_current;
+	}
+	return Poll::Done;
+}
+
+
+BatchStream::BatchStream(std::shared_ptr<BufferStream> pSource, size_t batchSize)
+	: _source{ pSource },
+	_batchSize{ batchSize }
+{
+	if (_batchSize == 0)
+	{
+		throw std::invalid_argument("BatchStream batch size must be at least 1");
+	}
+}
+
+bool BatchStream::next(Buffer & buffer)
+{
+	return poll(buffer, true) == Poll::Ready;
+}
+
+BufferStream::Poll BatchStream::tryNext(Buffer & buffer)
+{
+	return poll(buffer, false);
+}
+
+BufferStream::Poll BatchStream::poll(Buffer & buffer, bool wait)
+{
+	Buffer input;
+	while (_batch.getLength() < _batchSize)
+	{
+		auto result = pull(*_source, input, wait);
+		if (result == Poll::Pending)
+		{
+			return result;
+		}
+		if (result == Poll::Done)
+		{
+			break;
+		}
+		_batch += input;
+	}
+	if (_batch.getLength() == 0)
+	{
+		return Poll::Done;
+	}
+	buffer = std::move(_batch);
+	_batch = Buffer{};
+	return Poll::Ready;
+}
+
+
+BufferQueue::BufferQueue(size_t capacity)
+	: _capacity{ capacity > 0 ? capacity : 1 },
+	_closed{ false }
+{
+}
+
+bool BufferQueue::push(Buffer buffer)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_notFull.wait(lock, [this] { return _closed || (_buffers.size() < _capacity); });
+	if (_closed)
+	{
+		return false;
+	}
+	_buffers.push_back(std::move(buffer));
+	_notEmpty.notify_one();
+	return true;
+}
+
+bool BufferQueue::tryPush(Buffer & buffer)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_closed || (_buffers.size() >= _capacity))
+	{
+		return false;
+	}
+	_buffers.push_back(std::move(buffer));
+	_notEmpty.notify_one();
+	return true;
+}
+
+void BufferQueue::close()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_closed = true;
+	_notFull.notify_all();
+	_notEmpty.notify_all();
+}
+
+bool BufferQueue::isClosed()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _closed;
+}
+
+bool BufferQueue::next(Buffer & buffer)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_notEmpty.wait(lock, [this] { return _closed || !_buffers.empty(); });
+	if (_buffers.empty())
+	{
+		return false;
+	}
+	buffer = std::move(_buffers.front());
+	_buffers.pop_front();
+	_notFull.notify_one();
+	return true;
+}
+
+BufferStream::Poll BufferQueue::tryNext(Buffer & buffer)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_buffers.empty())
+	{
+		return _closed ? Poll::Done : Poll::Pending;
+	}
+	buffer = std::move(_buffers.front());
+	_buffers.pop_front();
+	_notFull.notify_one();
+	return Poll::Ready;
+}
+
+
+void pump(BufferStream & source, BufferQueue & destination)
+{
+	Buffer buffer;
+	while (source.next(buffer) && destination.push(std::move(buffer)))
+	{
+		buffer = Buffer{};
+	}
+	destination.close();
+}
+
+
+void StreamExecutor::pump(std::shared_ptr<BufferStream> pSource, std::shared_ptr<BufferQueue> pDestination)
+{
+	_tasks.push_back(Task{ pSource, pDestination, nullptr, Buffer{}, false });
+}
+
+void StreamExecutor::drain(std::shared_ptr<BufferStream> pSource, std::function<void(Buffer)> consume)
+{
+	_tasks.push_back(Task{ pSource, nullptr, consume, Buffer{}, false });
+}
+
+bool StreamExecutor::runOnce()
+{
+	bool progress = false;
+	for (size_t index = 0; index < _tasks.size();)
+	{
+		bool done = false;
+		progress |= advance(_tasks[index], done);
+		if (done)
+		{
+			if (_tasks[index].destination)
+			{
+				_tasks[index].destination->close();
+			}
+			_tasks.erase(_tasks.begin() + index);
+			progress = true;
+		}
+		else
+		{
+			++index;
+		}
+	}
+	return progress;
+}
+
+void StreamExecutor::run()
+{
+	while (!_tasks.empty())
+	{
+		if (!runOnce())
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool StreamExecutor::isIdle() const
+{
+	return _tasks.empty();
+}
+
+bool StreamExecutor::advance(Task & task, bool & done)
+{
+	if (!task.holding)
+	{
+		auto result = task.source->tryNext(task.held);
+		if (result != BufferStream::Poll::Ready)
+		{
+			done = (result == BufferStream::Poll::Done);
+			return false;
+		}
+		if (!task.destination)
+		{
+			task.consume(std::move(task.held));
+			task.held = Buffer{};
+			return true;
+		}
+		task.holding = true;
+	}
+	if (!task.destination->tryPush(task.held))
+	{
+		// A closed queue takes nothing more, so the task is finished
+		done = task.destination->isClosed();
+		return false;
+	}
+	task.held = Buffer{};
+	task.holding = false;
+	return true;
+}
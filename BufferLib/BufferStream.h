@@ -0,0 +1,171 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Buffer.h"
+
+	// A pull-based sequence of Buffers.  Stages are chained by wrapping one
+	// stream in another, and buffers are moved between stages, never copied.
+	// next() blocks, so a thread calling it on the last stage runs every stage
+	// in turn.  For stages to overlap on one thread, pump them into BufferQueues
+	// with a StreamExecutor, which uses the non-blocking tryNext().
+	class BufferStream
+	{
+	public:
+		enum class Poll { Ready, Pending, Done };
+
+		virtual ~BufferStream() {}
+		// Fetch the next buffer.  Returns false once the stream is exhausted.
+		virtual bool next(Buffer& buffer) = 0;
+		// Fetch the next buffer if there is one without waiting.  Pending means
+		// try again later.  Streams that never wait, such as file readers, can
+		// keep this default, which calls next().
+		virtual Poll tryNext(Buffer& buffer);
+	protected:
+		// Pull from source, by next() if wait is set and tryNext() if not
+		static Poll pull(BufferStream& source, Buffer& buffer, bool wait);
+	};
+
+
+	// Apply a function to every buffer
+	class MapStream : public BufferStream
+	{
+	public:
+		MapStream(std::shared_ptr<BufferStream> pSource, std::function<Buffer(Buffer)> transform);
+		virtual bool next(Buffer& buffer) override;
+		virtual Poll tryNext(Buffer& buffer) override;
+	private:
+		Poll poll(Buffer& buffer, bool wait);
+
+		std::shared_ptr<BufferStream> _source;
+		std::function<Buffer(Buffer)> _transform;
+	};
+
+
+	// Re-split the source at each delimiter.  Delimiters are dropped, and records
+	// that straddle source buffers are joined without copying.
+	class SplitStream : public BufferStream
+	{
+	public:
+		SplitStream(std::shared_ptr<BufferStream> pSource, char delimiter);
+		virtual bool next(Buffer& buffer) override;
+		virtual Poll tryNext(Buffer& buffer) override;
+	private:
+		Poll poll(Buffer& buffer, bool wait);
+		// Offset of the delimiter in fragment index, or npos if it has none
+		size_t findInFragment(size_t index) const;
+
+		std::shared_ptr<BufferStream> _source;
+		char _delimiter;
+		Buffer _pending;
+		// The first _searchedFragments fragments of _pending, _searchedLength bytes,
+		// have no delimiter, so each search carries on from there
+		size_t _searchedFragments;
+		size_t _searchedLength;
+		bool _sourceDone;
+	};
+
+
+	// Each source in turn, until all are exhausted
+	class ConcatenateStream : public BufferStream
+	{
+	public:
+		explicit ConcatenateStream(std::vector<std::shared_ptr<BufferStream>> sources);
+		virtual bool next(Buffer& buffer) override;
+		virtual Poll tryNext(Buffer& buffer) override;
+	private:
+		Poll poll(Buffer& buffer, bool wait);
+
+		std::vector<std::shared_ptr<BufferStream>> _sources;
+		size_t _current;
+	};
+
+
+	// Join consecutive buffers until each batch holds at least batchSize bytes.
+	// The final batch may be smaller.  Throws std::invalid_argument if batchSize is 0.
+	class BatchStream : public BufferStream
+	{
+	public:
+		BatchStream(std::shared_ptr<BufferStream> pSource, size_t batchSize);
+		virtual bool next(Buffer& buffer) override;
+		virtual Poll tryNext(Buffer& buffer) override;
+	private:
+		Poll poll(Buffer& buffer, bool wait);
+
+		std::shared_ptr<BufferStream> _source;
+		size_t _batchSize;
+		// Buffers joined so far, kept while the source is pending
+		Buffer _batch;
+	};
+
+
+	// Bounded hand-off between a producer and a consuming stream, for stages
+	// running on different threads.  push() blocks while the queue is full,
+	// which applies backpressure to the producer.
+	class BufferQueue : public BufferStream
+	{
+	public:
+		explicit BufferQueue(size_t capacity);
+
+		// Returns false if the queue has been closed
+		bool push(Buffer buffer);
+		// Push without waiting.  Returns false, leaving buffer alone, if the queue
+		// is full or closed.
+		bool tryPush(Buffer& buffer);
+		// No more buffers will be pushed.  next() returns false once drained.
+		void close();
+		bool isClosed();
+
+		virtual bool next(Buffer& buffer) override;
+		// Pending while the queue is empty but open
+		virtual Poll tryNext(Buffer& buffer) override;
+	private:
+		std::mutex _mutex;
+		std::condition_variable _notFull;
+		std::condition_variable _notEmpty;
+		std::deque<Buffer> _buffers;
+		size_t _capacity;
+		bool _closed;
+	};
+
+	// Drain a stream into a queue, then close it.  Typically run on its own thread.
+	void pump(BufferStream& source, BufferQueue& destination);
+
+
+	// Single-threaded run loop for pipelines of stages joined by BufferQueues.
+	// Each pass resumes every task whose source has a buffer ready and whose
+	// queue has room, so the stages overlap without a thread each.
+	class StreamExecutor
+	{
+	public:
+		// Move buffers from source into destination, closing it once source is done
+		void pump(std::shared_ptr<BufferStream> pSource, std::shared_ptr<BufferQueue> pDestination);
+		// Hand each buffer from source to consume
+		void drain(std::shared_ptr<BufferStream> pSource, std::function<void(Buffer)> consume);
+
+		// One pass over the tasks.  Returns whether any of them made progress.
+		bool runOnce();
+		// Run until every task's source is done.  While all tasks are waiting on
+		// queues fed from other threads, the thread is yielded between passes.
+		void run();
+		bool isIdle() const;
+	private:
+		struct Task
+		{
+			std::shared_ptr<BufferStream> source;
+			std::shared_ptr<BufferQueue> destination;
+			std::function<void(Buffer)> consume;
+			// Buffer pulled from the source but not yet pushed, if held
+			Buffer held;
+			bool holding;
+		};
+		// Move at most one buffer along, so no task starves the others.  Returns
+		// whether it made progress, and sets done once the task is finished.
+		static bool advance(Task& task, bool& done);
+
+		std::vector<Task> _tasks;
+	};
@@ -0,0 +1,206 @@
+#include "DirectFileReader.h"
+
+#include <cerrno>
+#include <system_error>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const size_t DirectFileReader::kDirectAlignment;
+
+DirectFileReader::DirectFileReader(const std::string & path, size_t blockSize, AlignedMemoryBlock::PageMode pageMode)
+	: _path{ path },
+	// Unbuffered reads must be whole multiples of the alignment
+	_blockSize{ ((blockSize + kDirectAlignment - 1) / kDirectAlignment) * kDirectAlignment },
+	_pageMode{ pageMode },
+#ifdef _WIN32
+	_handle{ INVALID_HANDLE_VALUE },
+#else
+	_fd{ -1 },
+#endif
+	_direct{ false },
+	_endOfFile{ false },
+	_position{ 0 }
+{
+	if (_blockSize == 0)
+	{
+		_blockSize = kDirectAlignment;
+	}
+	open(true);
+}
+
+DirectFileReader::~DirectFileReader()
+{
+#ifdef _WIN32
+	if (_handle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(_handle);
+	}
+#else
+	if (_fd >= 0)
+	{
+		close(_fd);
+	}
+#endif
+}
+
+bool DirectFileReader::isDirect() const
+{
+	return _direct;
+}
+
+void DirectFileReader::open(bool direct)
+{
+#ifdef _WIN32
+	if (_handle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(_handle);
+	}
+	DWORD flags = FILE_FLAG_SEQUENTIAL_SCAN | (direct ? FILE_FLAG_NO_BUFFERING : 0);
+	_handle = CreateFileA(_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+	if ((_handle == INVALID_HANDLE_VALUE) && direct)
+	{
+		open(false);
+		return;
+	}
+	if (_handle == INVALID_HANDLE_VALUE)
+	{
+		throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "open " + _path);
+	}
+	_direct = direct;
+#else
+	int flags = O_RDONLY;
+#ifdef O_DIRECT
+	if (direct)
+	{
+		flags |= O_DIRECT;
+	}
+#endif
+	_fd = ::open(_path.c_str(), flags);
+	if ((_fd < 0) && direct && (errno == EINVAL))
+	{
+		// File system does not support O_DIRECT
+		open(false);
+		return;
+	}
+	if (_fd < 0)
+	{
+		throw std::system_error(errno, std::generic_category(), "open " + _path);
+	}
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+	if (direct)
+	{
+		direct = (fcntl(_fd, F_NOCACHE, 1) == 0);
+	}
+#elif !defined(O_DIRECT)
+	direct = false;
+#endif
+	_direct = direct;
+#endif
+}
+
+size_t DirectFileReader::readBlock(char * pDestination, size_t length)
+{
+	size_t total = 0;
+	while (total < length)
+	{
+#ifdef _WIN32
+		DWORD bytesRead = 0;
+		if (!ReadFile(_handle, pDestination + total, static_cast<DWORD>(length - total), &bytesRead, nullptr))
+		{
+			throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "read " + _path);
+		}
+#else
+		auto bytesRead = ::read(_fd, pDestination + total, length - total);
+		if (bytesRead < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+#ifdef O_DIRECT
+			if ((errno == EINVAL) && _direct)
+			{
+				// Opened, but the device rejects this transfer unbuffered
+				if (fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) & ~O_DIRECT) == 0)
+				{
+					_direct = false;
+					continue;
+				}
+			}
+#endif
+			throw std::system_error(errno, std::generic_category(), "read " + _path);
+		}
+#endif
+		if (bytesRead == 0)
+		{
+			_endOfFile = true;
+			break;
+		}
+		total += bytesRead;
+		if (_direct && ((total % kDirectAlignment) != 0))
+		{
+			// Unbuffered reads only come back short at the end of the file
+			_endOfFile = true;
+			break;
+		}
+	}
+	return total;
+}
+
+uint64_t DirectFileReader::getFileSize() const
+{
+#ifdef _WIN32
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(_handle, &size))
+	{
+		throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "size " + _path);
+	}
+	return static_cast<uint64_t>(size.QuadPart);
+#else
+	struct stat status;
+	if (fstat(_fd, &status) != 0)
+	{
+		throw std::system_error(errno, std::generic_category(), "stat " + _path);
+	}
+	return static_cast<uint64_t>(status.st_size);
+#endif
+}
+
+bool DirectFileReader::next(Buffer & buffer)
+{
+	// Check the size first, so a file that's a whole number of blocks long
+	// doesn't cost an extra block to find the end.  It's checked afresh each
+	// time, in case the file has grown.
+	if (_endOfFile || (_position >= getFileSize()))
+	{
+		_endOfFile = true;
+		return false;
+	}
+	auto pBlock = std::make_shared<AlignedMemoryBlock>(_blockSize, kDirectAlignment, _pageMode);
+	auto length = readBlock(pBlock->getWritableMemory(), _blockSize);
+	if (length == 0)
+	{
+		return false;
+	}
+	_position += length;
+	pBlock->setLength(length);
+	buffer = Buffer{ pBlock };
+	return true;
+}
+
+Buffer DirectFileReader::readAll()
+{
+	Buffer result;
+	Buffer block;
+	while (next(block))
+	{
+		result += block;
+	}
+	return result;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "AlignedMemoryBlock.h"
+#include "BufferStream.h"
+
+	// Reads a file in blocks straight into AlignedMemoryBlocks, bypassing the
+	// page cache (O_DIRECT, or FILE_FLAG_NO_BUFFERING on Windows).  Falls back
+	// to ordinary buffered reads if the file system refuses unbuffered access.
+	// Each call to next() yields one block as a Buffer.
+	class DirectFileReader : public BufferStream
+	{
+	public:
+		// Alignment that satisfies unbuffered I/O on common devices
+		static const size_t kDirectAlignment = 4096;
+
+		explicit DirectFileReader(const std::string& path,
+			size_t blockSize = 4 * 1024 * 1024,
+			AlignedMemoryBlock::PageMode pageMode = AlignedMemoryBlock::PageMode::Normal);
+		DirectFileReader(const DirectFileReader&) = delete;
+		DirectFileReader& operator=(const DirectFileReader&) = delete;
+		virtual ~DirectFileReader();
+
+		// Whether reads are actually bypassing the page cache
+		bool isDirect() const;
+
+		virtual bool next(Buffer& buffer) override;
+		// Read the rest of the file into one Buffer, one fragment per block
+		Buffer readAll();
+
+	private:
+		void open(bool direct);
+		size_t readBlock(char* pDestination, size_t length);
+		uint64_t getFileSize() const;
+
+		std::string _path;
+		size_t _blockSize;
+		AlignedMemoryBlock::PageMode _pageMode;
+#ifdef _WIN32
+		void* _handle;
+#else
+		int _fd;
+#endif
+		bool _direct;
+		bool _endOfFile;
+		// Bytes read so far, so next() can tell it's at the end before allocating a block
+		uint64_t _position;
+	};
@@ -1,11 +1,25 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
 	class IMemoryBlock
 	{
 	public:
 		virtual ~IMemoryBlock() {}
-		virtual const char* getMemory() const = 0; // Do I want this?
+		// Start of the memory, or nullptr if it can't be accessed directly.  Fragments
+		// cache this, so it must not change over the life of the block.
+		virtual const char* getMemory() const = 0;
 		virtual size_t getLength() const = 0;
 		virtual size_t copy(size_t sourceOffset, size_t sourceLength, char* pDestination) const= 0;
 		virtual const char& operator[](size_t offset) const = 0;
+		// Power of two the start of the memory is guaranteed to be aligned to
+		virtual size_t getAlignment() const
+		{
+			auto address = reinterpret_cast<uintptr_t>(getMemory());
+			return (address == 0) ? 1 : static_cast<size_t>(address & (~address + 1));
+		}
+		// Hint that a range will be read soon.  Blocks whose memory is paged in on
+		// demand can start reading it; the default does nothing.
+		virtual void willNeed(size_t /*offset*/, size_t /*length*/) const {}
 	};
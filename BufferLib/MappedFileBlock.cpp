@@ -0,0 +1,142 @@
+#include "MappedFileBlock.h"
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFileBlock::MappedFileBlock(const std::string & path)
+	: _pMemory{ nullptr },
+	_length{ 0 }
+{
+#ifdef _WIN32
+	auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "open " + path);
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		auto error = GetLastError();
+		CloseHandle(file);
+		throw std::system_error(static_cast<int>(error), std::system_category(), "size " + path);
+	}
+	_length = static_cast<size_t>(size.QuadPart);
+	if (_length > 0)
+	{
+		// The view keeps the mapping alive, so neither handle needs to be kept
+		auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping != nullptr)
+		{
+			_pMemory = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			CloseHandle(mapping);
+		}
+		if (_pMemory == nullptr)
+		{
+			auto error = GetLastError();
+			CloseHandle(file);
+			throw std::system_error(static_cast<int>(error), std::system_category(), "map " + path);
+		}
+	}
+	CloseHandle(file);
+#else
+	auto fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		throw std::system_error(errno, std::generic_category(), "open " + path);
+	}
+	struct stat status;
+	if (fstat(fd, &status) != 0)
+	{
+		auto error = errno;
+		close(fd);
+		throw std::system_error(error, std::generic_category(), "stat " + path);
+	}
+	_length = static_cast<size_t>(status.st_size);
+	if (_length > 0)
+	{
+		// The mapping keeps the file open, so the descriptor needn't be kept
+		auto pMapped = mmap(nullptr, _length, PROT_READ, MAP_SHARED, fd, 0);
+		if (pMapped == MAP_FAILED)
+		{
+			auto error = errno;
+			close(fd);
+			throw std::system_error(error, std::generic_category(), "map " + path);
+		}
+		_pMemory = static_cast<const char*>(pMapped);
+	}
+	close(fd);
+#endif
+}
+
+MappedFileBlock::~MappedFileBlock()
+{
+	if (_pMemory != nullptr)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(_pMemory);
+#else
+		munmap(const_cast<char*>(_pMemory), _length);
+#endif
+	}
+}
+
+const char * MappedFileBlock::getMemory() const
+{
+	return _pMemory;
+}
+
+size_t MappedFileBlock::getLength() const
+{
+	return _length;
+}
+
+size_t MappedFileBlock::copy(size_t sourceOffset, size_t sourceLength, char * pDestination) const
+{
+	if (sourceOffset >= _length)
+	{
+		return 0;
+	}
+	auto toCopy = ((_length - sourceOffset) < sourceLength) ? _length - sourceOffset : sourceLength;
+	memcpy(pDestination, _pMemory + sourceOffset, toCopy);
+	return toCopy;
+}
+
+const char & MappedFileBlock::operator[](size_t offset) const
+{
+	return _pMemory[offset];
+}
+
+void MappedFileBlock::willNeed(size_t offset, size_t length) const
+{
+	if (offset >= _length)
+	{
+		return;
+	}
+	if (length > _length - offset)
+	{
+		length = _length - offset;
+	}
+#ifdef _WIN32
+#if defined(_WIN32_WINNT) && (_WIN32_WINNT >= 0x0602)
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = const_cast<char*>(_pMemory + offset);
+	range.NumberOfBytes = length;
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+	// madvise needs a page aligned start, and the mapping itself is page aligned
+	auto pageLength = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	auto start = offset - (offset % pageLength);
+	madvise(const_cast<char*>(_pMemory + start), offset + length - start, MADV_WILLNEED);
+#endif
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include "IMemoryBlock.h"
+
+	// Read-only memory block over a whole file mapped into memory.  Pages are
+	// only read from disk when they are first touched.
+	class MappedFileBlock : public IMemoryBlock
+	{
+	public:
+		explicit MappedFileBlock(const std::string& path);
+		MappedFileBlock(const MappedFileBlock&) = delete;
+		MappedFileBlock& operator=(const MappedFileBlock&) = delete;
+		virtual ~MappedFileBlock();
+
+		// Inherited via IMemoryBlock
+		virtual const char* getMemory() const override;
+		virtual size_t getLength() const override;
+		virtual size_t copy(size_t sourceOffset, size_t sourceLength, char* pDestination) const override;
+		virtual const char& operator[](size_t offset) const override;
+		// Asks the OS to read the range's pages ahead of access
+		virtual void willNeed(size_t offset, size_t length) const override;
+
+	private:
+		const char* _pMemory;
+		size_t _length;
+	};
@@ -0,0 +1,128 @@
+#include "MemoryResource.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace
+{
+	class NewDeleteMemoryResource : public IMemoryResource
+	{
+	public:
+		virtual void* allocate(size_t bytes, size_t alignment) override
+		{
+			if (alignment <= alignof(std::max_align_t))
+			{
+				return ::operator new(bytes);
+			}
+#ifdef _WIN32
+			auto pMemory = _aligned_malloc(bytes, alignment);
+#else
+			void* pMemory = nullptr;
+			if (posix_memalign(&pMemory, alignment, bytes) != 0)
+			{
+				pMemory = nullptr;
+			}
+#endif
+			if (pMemory == nullptr)
+			{
+				throw std::bad_alloc();
+			}
+			return pMemory;
+		}
+
+		virtual void deallocate(void* pMemory, size_t, size_t alignment) override
+		{
+			if (alignment <= alignof(std::max_align_t))
+			{
+				::operator delete(pMemory);
+				return;
+			}
+#ifdef _WIN32
+			_aligned_free(pMemory);
+#else
+			free(pMemory);
+#endif
+		}
+	};
+
+	char* alignPointer(char* pMemory, size_t alignment)
+	{
+		auto address = reinterpret_cast<uintptr_t>(pMemory);
+		return reinterpret_cast<char*>((address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1));
+	}
+}
+
+IMemoryResource * getDefaultMemoryResource()
+{
+	static NewDeleteMemoryResource resource;
+	return &resource;
+}
+
+
+MonotonicMemoryResource::MonotonicMemoryResource(size_t initialChunkSize, IMemoryResource * pUpstream)
+	: MonotonicMemoryResource(nullptr, 0, pUpstream)
+{
+	_nextChunkSize = (initialChunkSize < 64) ? 64 : initialChunkSize;
+}
+
+MonotonicMemoryResource::MonotonicMemoryResource(void * pInitial, size_t length, IMemoryResource * pUpstream)
+	: _upstream{ pUpstream },
+	_pInitial{ pInitial },
+	_initialLength{ length },
+	_pCurrent{ static_cast<char*>(pInitial) },
+	_remaining{ length },
+	_nextChunkSize{ (length < 4096) ? 4096 : length },
+	_chunks{ nullptr }
+{
+}
+
+MonotonicMemoryResource::~MonotonicMemoryResource()
+{
+	release();
+}
+
+void MonotonicMemoryResource::release()
+{
+	while (_chunks != nullptr)
+	{
+		auto pChunk = _chunks;
+		_chunks = pChunk->pNext;
+		_upstream->deallocate(pChunk, pChunk->length, alignof(std::max_align_t));
+	}
+	_pCurrent = static_cast<char*>(_pInitial);
+	_remaining = _initialLength;
+}
+
+void * MonotonicMemoryResource::allocate(size_t bytes, size_t alignment)
+{
+	auto pAligned = alignPointer(_pCurrent, alignment);
+	auto padding = static_cast<size_t>(pAligned - _pCurrent);
+	if ((_pCurrent == nullptr) || (padding + bytes > _remaining))
+	{
+		// Start a new chunk, big enough for this allocation and growing geometrically
+		auto needed = sizeof(Chunk) + bytes + alignment;
+		auto chunkLength = (_nextChunkSize < needed) ? needed : _nextChunkSize;
+		auto pChunk = static_cast<Chunk*>(_upstream->allocate(chunkLength, alignof(std::max_align_t)));
+		pChunk->pNext = _chunks;
+		pChunk->length = chunkLength;
+		_chunks = pChunk;
+		_nextChunkSize = chunkLength * 2;
+
+		_pCurrent = reinterpret_cast<char*>(pChunk + 1);
+		_remaining = chunkLength - sizeof(Chunk);
+		pAligned = alignPointer(_pCurrent, alignment);
+		padding = static_cast<size_t>(pAligned - _pCurrent);
+	}
+	_pCurrent = pAligned + bytes;
+	_remaining -= padding + bytes;
+	return pAligned;
+}
+
+void MonotonicMemoryResource::deallocate(void *, size_t, size_t)
+{
+}
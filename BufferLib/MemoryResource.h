@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+	// Source of memory for a Buffer's bookkeeping (its fragment list) and for
+	// memory block control blocks, in the style of std::pmr::memory_resource.
+	// Lets short-lived Buffers allocate from an arena that is freed all at once.
+	class IMemoryResource
+	{
+	public:
+		virtual ~IMemoryResource() {}
+		virtual void* allocate(size_t bytes, size_t alignment) = 0;
+		virtual void deallocate(void* pMemory, size_t bytes, size_t alignment) = 0;
+	};
+
+	// Global new and delete
+	IMemoryResource* getDefaultMemoryResource();
+
+
+	// Allocates from a bump pointer, growing by chunks from the upstream
+	// resource.  Deallocation does nothing.  Everything is freed together by
+	// release() or the destructor, which must not happen while any Buffer or
+	// memory block still uses the memory.
+	class MonotonicMemoryResource : public IMemoryResource
+	{
+	public:
+		explicit MonotonicMemoryResource(size_t initialChunkSize = 4096, IMemoryResource* pUpstream = getDefaultMemoryResource());
+		// Use pInitial first, e.g. an array on the stack, before allocating chunks
+		MonotonicMemoryResource(void* pInitial, size_t length, IMemoryResource* pUpstream = getDefaultMemoryResource());
+		MonotonicMemoryResource(const MonotonicMemoryResource&) = delete;
+		MonotonicMemoryResource& operator=(const MonotonicMemoryResource&) = delete;
+		virtual ~MonotonicMemoryResource();
+
+		void release();
+
+		virtual void* allocate(size_t bytes, size_t alignment) override;
+		virtual void deallocate(void* pMemory, size_t bytes, size_t alignment) override;
+
+	private:
+		struct Chunk
+		{
+			Chunk* pNext;
+			size_t length;
+		};
+
+		IMemoryResource* _upstream;
+		void* _pInitial;
+		size_t _initialLength;
+		char* _pCurrent;
+		size_t _remaining;
+		size_t _nextChunkSize;
+		Chunk* _chunks;
+	};
+
+
+	// Standard allocator over an IMemoryResource, like std::pmr::polymorphic_allocator.
+	// Containers keep their resource when assigned or swapped.  Copy-constructed
+	// containers use the default resource, as with std::pmr, so a copy kept
+	// after an arena is released doesn't point into it.
+	template<typename T>
+	class ResourceAllocator
+	{
+	public:
+		typedef T value_type;
+
+		ResourceAllocator() : _resource{ getDefaultMemoryResource() } {}
+		ResourceAllocator(IMemoryResource* pResource) : _resource{ pResource } {}
+		template<typename U>
+		ResourceAllocator(const ResourceAllocator<U>& other) : _resource{ other.getResource() } {}
+
+		T* allocate(size_t count)
+		{
+			return static_cast<T*>(_resource->allocate(count * sizeof(T), alignof(T)));
+		}
+		void deallocate(T* pMemory, size_t count)
+		{
+			_resource->deallocate(pMemory, count * sizeof(T), alignof(T));
+		}
+
+		IMemoryResource* getResource() const { return _resource; }
+		ResourceAllocator select_on_container_copy_construction() const { return ResourceAllocator(); }
+
+	private:
+		IMemoryResource* _resource;
+	};
+
+	template<typename T, typename U>
+	bool operator==(const ResourceAllocator<T>& lhs, const ResourceAllocator<U>& rhs)
+	{
+		return lhs.getResource() == rhs.getResource();
+	}
+
+	template<typename T, typename U>
+	bool operator!=(const ResourceAllocator<T>& lhs, const ResourceAllocator<U>& rhs)
+	{
+		return !(lhs == rhs);
+	}
+
+	// Create a memory block, with its shared_ptr control block, in the given resource
+	template<typename T, typename... Args>
+	std::shared_ptr<T> makeMemoryBlock(IMemoryResource* pResource, Args&&... args)
+	{
+		return std::allocate_shared<T>(ResourceAllocator<T>(pResource), std::forward<Args>(args)...);
+	}
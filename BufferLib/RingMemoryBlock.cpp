@@ -0,0 +1,364 @@
+#include "RingMemoryBlock.h"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// A taken part of the ring, as a block of its own so that the ring can tell
+// when the last fragment referring to it has gone
+class RingMemoryBlock::Region : public IMemoryBlock
+{
+public:
+	Region() : _pMemory{ nullptr }, _length{ 0 }, _released{ true } {}
+
+	virtual const char* getMemory() const override { return _pMemory; }
+	virtual size_t getLength() const override { return _length; }
+	virtual size_t copy(size_t sourceOffset, size_t sourceLength, char* pDestination) const override
+	{
+		if (sourceOffset >= _length)
+		{
+			return 0;
+		}
+		auto toCopy = ((_length - sourceOffset) < sourceLength) ? _length - sourceOffset : sourceLength;
+		memcpy(pDestination, _pMemory + sourceOffset, toCopy);
+		return toCopy;
+	}
+	virtual const char& operator[](size_t offset) const override { return _pMemory[offset]; }
+
+	const char* _pMemory;
+	size_t _length;
+	bool _released;
+};
+
+// Fixed set of slots for the shared_ptr control blocks of regions, so taking
+// a region doesn't allocate.  Shared with the allocators using it, as a control
+// block is deallocated after its deleter (and so maybe the ring) has gone.
+class RingMemoryBlock::ControlBlockPool
+{
+public:
+	static const size_t kSlotSize = 128;
+
+	explicit ControlBlockPool(size_t slotCount)
+		: _slots(slotCount * kSlotSize / sizeof(std::max_align_t))
+	{
+		_free.reserve(slotCount);
+		for (size_t index = slotCount; index > 0; --index)
+		{
+			_free.push_back(index - 1);
+		}
+	}
+
+	void* allocate(size_t bytes, size_t alignment)
+	{
+		if ((bytes <= kSlotSize) && (alignment <= alignof(std::max_align_t)))
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (!_free.empty())
+			{
+				auto index = _free.back();
+				_free.pop_back();
+				return reinterpret_cast<char*>(_slots.data()) + index * kSlotSize;
+			}
+		}
+		// Out of slots, so fall back to the heap
+		return ::operator new(bytes);
+	}
+
+	void deallocate(void* pMemory)
+	{
+		auto pSlots = reinterpret_cast<char*>(_slots.data());
+		auto pChar = static_cast<char*>(pMemory);
+		if ((pChar >= pSlots) && (pChar < pSlots + _slots.size() * sizeof(std::max_align_t)))
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_free.push_back((pChar - pSlots) / kSlotSize);
+			return;
+		}
+		::operator delete(pMemory);
+	}
+
+private:
+	std::mutex _mutex;
+	std::vector<std::max_align_t> _slots;
+	std::vector<size_t> _free;
+};
+
+const size_t RingMemoryBlock::ControlBlockPool::kSlotSize;
+
+template<typename T>
+class RingMemoryBlock::PoolAllocator
+{
+public:
+	typedef T value_type;
+
+	explicit PoolAllocator(std::shared_ptr<ControlBlockPool> pPool) : _pool{ pPool } {}
+	template<typename U>
+	PoolAllocator(const PoolAllocator<U>& other) : _pool{ other._pool } {}
+
+	T* allocate(size_t count) { return static_cast<T*>(_pool->allocate(count * sizeof(T), alignof(T))); }
+	void deallocate(T* pMemory, size_t) { _pool->deallocate(pMemory); }
+
+	template<typename U>
+	bool operator==(const PoolAllocator<U>& rhs) const { return _pool == rhs._pool; }
+	template<typename U>
+	bool operator!=(const PoolAllocator<U>& rhs) const { return _pool != rhs._pool; }
+
+	std::shared_ptr<ControlBlockPool> _pool;
+};
+
+// Deleter for a region.  Keeps the ring alive until the region is released.
+struct RingMemoryBlock::RegionReleaser
+{
+	std::shared_ptr<RingMemoryBlock> ring;
+	size_t regionIndex;
+
+	void operator()(IMemoryBlock*) const
+	{
+		ring->release(regionIndex);
+	}
+};
+
+std::shared_ptr<RingMemoryBlock> RingMemoryBlock::create(size_t capacity, bool mirrored, size_t maxRegions)
+{
+	return std::shared_ptr<RingMemoryBlock>(new RingMemoryBlock(capacity, mirrored, maxRegions));
+}
+
+RingMemoryBlock::RingMemoryBlock(size_t capacity, bool mirrored, size_t maxRegions)
+	: _pMemory{ nullptr },
+	_capacity{ (capacity == 0) ? 1 : capacity },
+	_mirrored{ false },
+	_tail{ 0 },
+	_taken{ 0 },
+	_head{ 0 },
+	_regionTail{ 0 },
+	_regionCount{ 0 },
+	// A control block is freed a little after its region is released, so allow some spare
+	_controlBlocks{ std::make_shared<ControlBlockPool>(maxRegions + 16) }
+{
+	_mirrored = mirrored && mapMirrored();
+	if (!_mirrored)
+	{
+		_storage.reset(new AlignedMemoryBlock(_capacity, 64));
+		_pMemory = _storage->getWritableMemory();
+	}
+	_regions.reserve(maxRegions);
+	for (size_t index = 0; index < ((maxRegions == 0) ? 1 : maxRegions); ++index)
+	{
+		_regions.emplace_back(new Region());
+	}
+}
+
+RingMemoryBlock::~RingMemoryBlock()
+{
+#ifndef _WIN32
+	if (_mirrored)
+	{
+		munmap(_pMemory, 2 * _capacity);
+	}
+#endif
+}
+
+bool RingMemoryBlock::mapMirrored()
+{
+#if defined(__linux__)
+	// Map the same pages twice, one copy straight after the other
+	auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	auto capacity = ((_capacity + pageSize - 1) / pageSize) * pageSize;
+	auto fd = memfd_create("BufferLibRing", MFD_CLOEXEC);
+	if (fd < 0)
+	{
+		return false;
+	}
+	auto pReserved = (ftruncate(fd, static_cast<off_t>(capacity)) == 0)
+		? mmap(nullptr, 2 * capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+		: MAP_FAILED;
+	if (pReserved == MAP_FAILED)
+	{
+		close(fd);
+		return false;
+	}
+	auto pFirst = mmap(pReserved, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+	auto pSecond = mmap(static_cast<char*>(pReserved) + capacity, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+	close(fd);
+	if ((pFirst == MAP_FAILED) || (pSecond == MAP_FAILED))
+	{
+		munmap(pReserved, 2 * capacity);
+		return false;
+	}
+	_pMemory = static_cast<char*>(pReserved);
+	_capacity = capacity;
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool RingMemoryBlock::isMirrored() const
+{
+	return _mirrored;
+}
+
+size_t RingMemoryBlock::getCapacity() const
+{
+	return _capacity;
+}
+
+size_t RingMemoryBlock::getFreeLength() const
+{
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	return _capacity - static_cast<size_t>(_head - _tail);
+}
+
+size_t RingMemoryBlock::getReceivedLength() const
+{
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	return static_cast<size_t>(_head - _taken);
+}
+
+size_t RingMemoryBlock::getWritableSpans(char * pSpans[2], size_t lengths[2])
+{
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	auto start = static_cast<size_t>(_head % _capacity);
+	auto free = _capacity - static_cast<size_t>(_head - _tail);
+	if (free == 0)
+	{
+		return 0;
+	}
+	pSpans[0] = _pMemory + start;
+	if (_mirrored || (start + free <= _capacity))
+	{
+		lengths[0] = free;
+		return 1;
+	}
+	lengths[0] = _capacity - start;
+	pSpans[1] = _pMemory;
+	lengths[1] = free - lengths[0];
+	return 2;
+}
+
+void RingMemoryBlock::commit(size_t length)
+{
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	auto free = _capacity - static_cast<size_t>(_head - _tail);
+	_head += (length > free) ? free : length;
+}
+
+#ifndef _WIN32
+long RingMemoryBlock::receive(int fd)
+{
+	char* pSpans[2];
+	size_t lengths[2];
+	auto spanCount = getWritableSpans(pSpans, lengths);
+	if (spanCount == 0)
+	{
+		errno = ENOBUFS;
+		return -1;
+	}
+	iovec iov[2];
+	for (size_t index = 0; index < spanCount; ++index)
+	{
+		iov[index].iov_base = pSpans[index];
+		iov[index].iov_len = lengths[index];
+	}
+	auto received = readv(fd, iov, static_cast<int>(spanCount));
+	if (received > 0)
+	{
+		commit(static_cast<size_t>(received));
+	}
+	return static_cast<long>(received);
+}
+#endif
+
+Buffer RingMemoryBlock::take(size_t length, IMemoryResource * pResource)
+{
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	if (length > _head - _taken)
+	{
+		throw std::length_error("RingMemoryBlock::take beyond the data received");
+	}
+	Buffer result{ pResource };
+	if (length == 0)
+	{
+		return result;
+	}
+
+	auto start = static_cast<size_t>(_taken % _capacity);
+	auto wraps = !_mirrored && (start + length > _capacity);
+	if (_regionCount + (wraps ? 2 : 1) > _regions.size())
+	{
+		throw std::length_error("RingMemoryBlock has too many Buffers outstanding");
+	}
+	// Appended straight onto the result, so the only allocations are its
+	// fragment lists
+	result.reserve(2);
+	if (wraps)
+	{
+		auto firstLength = _capacity - start;
+		result.append(takeRegion(start, firstLength));
+		result.append(takeRegion(0, length - firstLength));
+	}
+	else
+	{
+		result.append(takeRegion(start, length));
+	}
+	return result;
+}
+
+std::shared_ptr<IMemoryBlock> RingMemoryBlock::takeRegion(size_t start, size_t length)
+{
+	// Called with the lock held.  Take the bytes before creating the shared_ptr,
+	// as it releases them again if creation fails.
+	auto regionIndex = (_regionTail + _regionCount) % _regions.size();
+	auto& region = *_regions[regionIndex];
+	region._pMemory = _pMemory + start;
+	region._length = length;
+	region._released = false;
+	++_regionCount;
+	_taken += length;
+	return std::shared_ptr<IMemoryBlock>(&region, RegionReleaser{ shared_from_this(), regionIndex }, PoolAllocator<char>(_controlBlocks));
+}
+
+void RingMemoryBlock::release(size_t regionIndex)
+{
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	_regions[regionIndex]->_released = true;
+	while ((_regionCount > 0) && _regions[_regionTail]->_released)
+	{
+		_tail += _regions[_regionTail]->_length;
+		_regionTail = (_regionTail + 1) % _regions.size();
+		--_regionCount;
+	}
+}
+
+const char * RingMemoryBlock::getMemory() const
+{
+	return _pMemory;
+}
+
+size_t RingMemoryBlock::getLength() const
+{
+	return _capacity;
+}
+
+size_t RingMemoryBlock::copy(size_t sourceOffset, size_t sourceLength, char * pDestination) const
+{
+	if (sourceOffset >= _capacity)
+	{
+		return 0;
+	}
+	auto toCopy = ((_capacity - sourceOffset) < sourceLength) ? _capacity - sourceOffset : sourceLength;
+	memcpy(pDestination, _pMemory + sourceOffset, toCopy);
+	return toCopy;
+}
+
+const char & RingMemoryBlock::operator[](size_t offset) const
+{
+	return _pMemory[offset];
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "AlignedMemoryBlock.h"
+#include "Buffer.h"
+#include "IMemoryBlock.h"
+
+	// Fixed circular receive area for long-lived connections.  Data is received
+	// into the free space (e.g. with readv) and handed out as Buffers that refer
+	// to the ring directly.  Space is reclaimed, oldest first, as soon as every
+	// Buffer referring to it has been released.  The ring's own bookkeeping is
+	// allocated up front, so each take() allocates only the new Buffer's two
+	// fragment lists, from its IMemoryResource.
+	//
+	// Where supported (Linux), the ring is mapped twice back to back, so a view
+	// that wraps around the end is still contiguous and becomes one fragment.
+	// Otherwise a wrapping view becomes two fragments.
+	class RingMemoryBlock : public IMemoryBlock, public std::enable_shared_from_this<RingMemoryBlock>
+	{
+	public:
+		// A mirrored ring's capacity is rounded up to a whole number of pages.
+		// maxRegions limits how many taken Buffers may be outstanding at once.
+		static std::shared_ptr<RingMemoryBlock> create(size_t capacity, bool mirrored = true, size_t maxRegions = 1024);
+		RingMemoryBlock(const RingMemoryBlock&) = delete;
+		RingMemoryBlock& operator=(const RingMemoryBlock&) = delete;
+		virtual ~RingMemoryBlock();
+
+		bool isMirrored() const;
+		size_t getCapacity() const;
+		// Space available to receive into
+		size_t getFreeLength() const;
+		// Received but not yet taken
+		size_t getReceivedLength() const;
+
+		// The free space, as one span, or two if it wraps and the ring isn't
+		// mirrored.  Returns the number of spans.
+		size_t getWritableSpans(char* pSpans[2], size_t lengths[2]);
+		// Record that length bytes have been written to the start of the free space
+		void commit(size_t length);
+#ifndef _WIN32
+		// readv into the free space and commit what arrives.  Returns as readv does.
+		long receive(int fd);
+#endif
+
+		// Take the oldest length bytes received.  Throws std::length_error if more
+		// than has been received is asked for, or maxRegions are outstanding.
+		Buffer take(size_t length, IMemoryResource* pResource = getDefaultMemoryResource());
+
+		// Inherited via IMemoryBlock, covering the whole ring
+		virtual const char* getMemory() const override;
+		virtual size_t getLength() const override;
+		virtual size_t copy(size_t sourceOffset, size_t sourceLength, char* pDestination) const override;
+		virtual const char& operator[](size_t offset) const override;
+
+	private:
+		class Region;
+		class ControlBlockPool;
+		template<typename T> class PoolAllocator;
+		struct RegionReleaser;
+
+		RingMemoryBlock(size_t capacity, bool mirrored, size_t maxRegions);
+		bool mapMirrored();
+		std::shared_ptr<IMemoryBlock> takeRegion(size_t start, size_t length);
+		void release(size_t regionIndex);
+
+		// Recursive, as a region can be released within take() if creating it fails
+		mutable std::recursive_mutex _mutex;
+		char* _pMemory;
+		size_t _capacity;
+		bool _mirrored;
+		std::unique_ptr<AlignedMemoryBlock> _storage;
+
+		// Positions count bytes since creation, so only grow.  Received data lies
+		// between _taken and _head, and taken data between _tail and _taken.
+		unsigned long long _tail;
+		unsigned long long _taken;
+		unsigned long long _head;
+
+		// Taken regions, in order, as a circular list of maxRegions
+		std::vector<std::unique_ptr<Region>> _regions;
+		size_t _regionTail;
+		size_t _regionCount;
+		std::shared_ptr<ControlBlockPool> _controlBlocks;
+	};
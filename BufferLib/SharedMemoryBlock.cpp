@@ -0,0 +1,188 @@
+#include "SharedMemoryBlock.h"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <system_error>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#if !defined(_WIN32)
+	int createSharedMemory()
+	{
+#if defined(__linux__)
+		auto fd = memfd_create("BufferLib", MFD_CLOEXEC);
+#else
+		// No memfd, so create a named object and unlink it straight away
+		static std::atomic<unsigned> sequence{ 0 };
+		int fd = -1;
+		for (int attempt = 0; (fd < 0) && (attempt < 16); ++attempt)
+		{
+			auto name = "/BufferLib." + std::to_string(getpid()) + "." + std::to_string(sequence++);
+			fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+			if (fd >= 0)
+			{
+				shm_unlink(name.c_str());
+			}
+		}
+#endif
+		if (fd < 0)
+		{
+			throw std::system_error(errno, std::generic_category(), "create shared memory");
+		}
+		return fd;
+	}
+#endif
+}
+
+SharedMemoryBlock::SharedMemoryBlock(size_t length)
+	: _pMemory{ nullptr },
+	_length{ length },
+	_writable{ true },
+#ifdef _WIN32
+	_handle{ nullptr },
+#else
+	_fd{ -1 },
+#endif
+	_remoteReferences{ 0 }
+{
+	// Map at least one byte, so an empty block still has a valid address
+	auto mappedLength = (length == 0) ? 1 : length;
+#ifdef _WIN32
+	auto size = static_cast<unsigned long long>(mappedLength);
+	_handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+	if (_handle == nullptr)
+	{
+		throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "create shared memory");
+	}
+	_pMemory = static_cast<char*>(MapViewOfFile(_handle, FILE_MAP_ALL_ACCESS, 0, 0, mappedLength));
+	if (_pMemory == nullptr)
+	{
+		auto error = GetLastError();
+		CloseHandle(_handle);
+		throw std::system_error(static_cast<int>(error), std::system_category(), "map shared memory");
+	}
+#else
+	_fd = createSharedMemory();
+	if (ftruncate(_fd, static_cast<off_t>(mappedLength)) != 0)
+	{
+		auto error = errno;
+		close(_fd);
+		throw std::system_error(error, std::generic_category(), "size shared memory");
+	}
+	auto pMapped = mmap(nullptr, mappedLength, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+	if (pMapped == MAP_FAILED)
+	{
+		auto error = errno;
+		close(_fd);
+		throw std::system_error(error, std::generic_category(), "map shared memory");
+	}
+	_pMemory = static_cast<char*>(pMapped);
+#endif
+}
+
+#ifndef _WIN32
+SharedMemoryBlock::SharedMemoryBlock(int fd, std::function<void()> onRelease)
+	: _pMemory{ nullptr },
+	_length{ 0 },
+	_writable{ false },
+	_fd{ -1 },
+	_onRelease{ onRelease },
+	_remoteReferences{ 0 }
+{
+	struct stat status;
+	if (fstat(fd, &status) != 0)
+	{
+		auto error = errno;
+		close(fd);
+		throw std::system_error(error, std::generic_category(), "stat shared memory");
+	}
+	_length = static_cast<size_t>(status.st_size);
+	auto pMapped = mmap(nullptr, (_length == 0) ? 1 : _length, PROT_READ, MAP_SHARED, fd, 0);
+	// The mapping stays valid after the descriptor is closed.  Keep mmap's
+	// errno, as close() may overwrite it.
+	auto error = errno;
+	close(fd);
+	if (pMapped == MAP_FAILED)
+	{
+		throw std::system_error(error, std::generic_category(), "map shared memory");
+	}
+	_pMemory = static_cast<char*>(pMapped);
+}
+#endif
+
+SharedMemoryBlock::~SharedMemoryBlock()
+{
+#ifdef _WIN32
+	UnmapViewOfFile(_pMemory);
+	CloseHandle(_handle);
+#else
+	munmap(_pMemory, (_length == 0) ? 1 : _length);
+	if (_fd >= 0)
+	{
+		close(_fd);
+	}
+#endif
+	if (_onRelease)
+	{
+		_onRelease();
+	}
+}
+
+char * SharedMemoryBlock::getWritableMemory()
+{
+	return _writable ? _pMemory : nullptr;
+}
+
+#ifdef _WIN32
+void * SharedMemoryBlock::getHandle() const
+{
+	return _handle;
+}
+#else
+int SharedMemoryBlock::getFileDescriptor() const
+{
+	return _fd;
+}
+#endif
+
+bool SharedMemoryBlock::isInUseRemotely() const
+{
+	return _remoteReferences.load() > 0;
+}
+
+const char * SharedMemoryBlock::getMemory() const
+{
+	return _pMemory;
+}
+
+size_t SharedMemoryBlock::getLength() const
+{
+	return _length;
+}
+
+size_t SharedMemoryBlock::copy(size_t sourceOffset, size_t sourceLength, char * pDestination) const
+{
+	if (sourceOffset >= _length)
+	{
+		return 0;
+	}
+	auto toCopy = ((_length - sourceOffset) < sourceLength) ? _length - sourceOffset : sourceLength;
+	memcpy(pDestination, _pMemory + sourceOffset, toCopy);
+	return toCopy;
+}
+
+const char & SharedMemoryBlock::operator[](size_t offset) const
+{
+	return _pMemory[offset];
+}
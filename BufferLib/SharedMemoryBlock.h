@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include "IMemoryBlock.h"
+
+	// Memory block in an anonymous shared memory object (memfd on Linux), so
+	// it can be mapped by another process and exchanged without copying.
+	// See SharedMemoryChannel for passing Buffers of these blocks between processes.
+	class SharedMemoryBlock : public IMemoryBlock
+	{
+	public:
+		// Create a new, writable shared memory block
+		explicit SharedMemoryBlock(size_t length);
+#ifndef _WIN32
+		// Map a block received from another process, read only.  Takes ownership of
+		// the descriptor.  onRelease runs when the block is destroyed.
+		SharedMemoryBlock(int fd, std::function<void()> onRelease);
+#endif
+		SharedMemoryBlock(const SharedMemoryBlock&) = delete;
+		SharedMemoryBlock& operator=(const SharedMemoryBlock&) = delete;
+		virtual ~SharedMemoryBlock();
+
+		// nullptr if the block was received from another process
+		char* getWritableMemory();
+#ifdef _WIN32
+		void* getHandle() const;
+#else
+		int getFileDescriptor() const;
+#endif
+		// Whether another process still holds fragments of this block.  Once
+		// false, the memory can be safely rewritten and sent again.
+		bool isInUseRemotely() const;
+
+		// Inherited via IMemoryBlock
+		virtual const char* getMemory() const override;
+		virtual size_t getLength() const override;
+		virtual size_t copy(size_t sourceOffset, size_t sourceLength, char* pDestination) const override;
+		virtual const char& operator[](size_t offset) const override;
+
+	private:
+		friend class SharedMemoryChannel;
+
+		char* _pMemory;
+		size_t _length;
+		bool _writable;
+#ifdef _WIN32
+		void* _handle;
+#else
+		int _fd;
+#endif
+		std::function<void()> _onRelease;
+		// Maintained by SharedMemoryChannel as blocks are sent and released
+		std::atomic<int> _remoteReferences;
+	};
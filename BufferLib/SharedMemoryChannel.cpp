@@ -0,0 +1,407 @@
+#include "SharedMemoryChannel.h"
+
+#ifndef _WIN32
+
+#include "AlignedMemoryBlock.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+	enum MessageType : uint32_t
+	{
+		kBufferMessage = 1,
+		kReleaseMessage = 2
+	};
+
+	// Sent as one record, carrying the descriptors.  A buffer message is followed
+	// by a second record with the block ids, the extents, then the bytes of any
+	// inline fragments.
+	struct MessageHeader
+	{
+		uint32_t type;
+		uint32_t blockCount;
+		uint64_t extentCount;
+		// Block released, for release messages
+		uint64_t blockId;
+		uint64_t inlineLength;
+	};
+
+	// Block index of an extent whose offset is into the inline bytes
+	const uint64_t kInlineExtent = UINT64_MAX;
+
+	// MSG_NOSIGNAL and MSG_CMSG_CLOEXEC are Linux only.  Elsewhere SIGPIPE is
+	// turned off with SO_NOSIGPIPE, and descriptors are marked close-on-exec
+	// once received.
+#ifdef MSG_NOSIGNAL
+	const int kSendFlags = MSG_NOSIGNAL;
+#else
+	const int kSendFlags = 0;
+#endif
+#ifdef MSG_CMSG_CLOEXEC
+	const int kReceiveFlags = MSG_CMSG_CLOEXEC;
+#else
+	const int kReceiveFlags = 0;
+#endif
+
+	void closeAll(const std::vector<int>& fds)
+	{
+		for (auto fd : fds)
+		{
+			close(fd);
+		}
+	}
+
+	struct Extent
+	{
+		uint64_t blockIndex;
+		uint64_t offset;
+		uint64_t length;
+	};
+
+	void sendRecord(int fd, const void* pData, size_t length, const std::vector<int>& fds)
+	{
+		iovec iov;
+		iov.iov_base = const_cast<void*>(pData);
+		iov.iov_len = length;
+		msghdr message;
+		memset(&message, 0, sizeof(message));
+		message.msg_iov = &iov;
+		message.msg_iovlen = 1;
+
+		std::vector<char> control(fds.empty() ? 0 : CMSG_SPACE(fds.size() * sizeof(int)));
+		if (!fds.empty())
+		{
+			message.msg_control = control.data();
+			message.msg_controllen = control.size();
+			auto pControl = CMSG_FIRSTHDR(&message);
+			pControl->cmsg_level = SOL_SOCKET;
+			pControl->cmsg_type = SCM_RIGHTS;
+			pControl->cmsg_len = CMSG_LEN(fds.size() * sizeof(int));
+			memcpy(CMSG_DATA(pControl), fds.data(), fds.size() * sizeof(int));
+		}
+
+		while (sendmsg(fd, &message, kSendFlags) < 0)
+		{
+			if (errno != EINTR)
+			{
+				throw std::system_error(errno, std::generic_category(), "send shared memory message");
+			}
+		}
+	}
+
+	// Returns the record length, or 0 if the peer has closed the socket
+	size_t receiveRecord(int fd, void* pData, size_t length, std::vector<int>* pFds, int flags)
+	{
+		iovec iov;
+		iov.iov_base = pData;
+		iov.iov_len = length;
+		msghdr message;
+		memset(&message, 0, sizeof(message));
+		message.msg_iov = &iov;
+		message.msg_iovlen = 1;
+		std::vector<char> control(CMSG_SPACE(SharedMemoryChannel::kMaxBlocksPerBuffer * sizeof(int)));
+		message.msg_control = control.data();
+		message.msg_controllen = control.size();
+
+		ssize_t received;
+		while ((received = recvmsg(fd, &message, flags | kReceiveFlags)) < 0)
+		{
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+			{
+				return 0;
+			}
+			if (errno != EINTR)
+			{
+				throw std::system_error(errno, std::generic_category(), "receive shared memory message");
+			}
+		}
+
+		std::vector<int> fds;
+		for (auto pControl = CMSG_FIRSTHDR(&message); pControl != nullptr; pControl = CMSG_NXTHDR(&message, pControl))
+		{
+			if ((pControl->cmsg_level == SOL_SOCKET) && (pControl->cmsg_type == SCM_RIGHTS))
+			{
+				auto count = (pControl->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+				auto first = fds.size();
+				fds.resize(first + count);
+				memcpy(fds.data() + first, CMSG_DATA(pControl), count * sizeof(int));
+			}
+		}
+#ifndef MSG_CMSG_CLOEXEC
+		for (auto received : fds)
+		{
+			fcntl(received, F_SETFD, FD_CLOEXEC);
+		}
+#endif
+		if ((message.msg_flags & (MSG_CTRUNC | MSG_TRUNC)) != 0)
+		{
+			// Some descriptors or bytes were dropped, so the record can't be used
+			closeAll(fds);
+			throw std::runtime_error("Malformed shared memory message");
+		}
+		if (pFds != nullptr)
+		{
+			pFds->insert(pFds->end(), fds.begin(), fds.end());
+		}
+		else
+		{
+			closeAll(fds);
+		}
+		return static_cast<size_t>(received);
+	}
+}
+
+const size_t SharedMemoryChannel::kMaxBlocksPerBuffer;
+const size_t SharedMemoryChannel::kMaxFragmentsPerBuffer;
+
+SharedMemoryChannel::SharedMemoryChannel(int socket)
+	: _socket{ std::make_shared<Socket>() }
+{
+	_socket->fd = socket;
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+	int on = 1;
+	setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+}
+
+SharedMemoryChannel::~SharedMemoryChannel()
+{
+	// Blocks received earlier may still send releases, so stop them first
+	std::lock_guard<std::mutex> lock(_socket->mutex);
+	close(_socket->fd);
+	_socket->fd = -1;
+	for (auto& outstanding : _outstanding)
+	{
+		outstanding.second.first->_remoteReferences -= static_cast<int>(outstanding.second.second);
+	}
+}
+
+void SharedMemoryChannel::send(const Buffer & buffer)
+{
+	std::vector<std::shared_ptr<SharedMemoryBlock>> blocks;
+	std::map<SharedMemoryBlock*, uint64_t> blockIndices;
+	std::vector<Extent> extents;
+	// Inline fragments have no block to share, so their bytes go in the message
+	std::string inlineBytes;
+	for (auto& fragment : buffer.getFragments())
+	{
+		if (fragment.isInline())
+		{
+			extents.push_back(Extent{ kInlineExtent, inlineBytes.size(), fragment.getLength() });
+			inlineBytes.append(fragment.getMemory(), fragment.getLength());
+			continue;
+		}
+		auto pBlock = std::dynamic_pointer_cast<SharedMemoryBlock>(fragment.getMemoryBlock());
+		if (!pBlock || !pBlock->_writable)
+		{
+			throw std::invalid_argument("Buffer sent over a SharedMemoryChannel must be made of SharedMemoryBlocks");
+		}
+		auto found = blockIndices.find(pBlock.get());
+		if (found == blockIndices.end())
+		{
+			found = blockIndices.emplace(pBlock.get(), blocks.size()).first;
+			blocks.push_back(pBlock);
+		}
+		extents.push_back(Extent{ found->second, fragment.getOffset(), fragment.getLength() });
+	}
+	if (blocks.size() > kMaxBlocksPerBuffer)
+	{
+		throw std::invalid_argument("Buffer spans too many SharedMemoryBlocks to send");
+	}
+	if (extents.size() > kMaxFragmentsPerBuffer)
+	{
+		throw std::invalid_argument("Buffer has too many fragments to send");
+	}
+
+	MessageHeader header{ kBufferMessage, static_cast<uint32_t>(blocks.size()), extents.size(), 0, inlineBytes.size() };
+	std::vector<int> fds;
+	auto extentsLength = extents.size() * sizeof(Extent);
+	std::vector<char> tables(blocks.size() * sizeof(uint64_t) + extentsLength + inlineBytes.size());
+	auto pBlockIds = reinterpret_cast<uint64_t*>(tables.data());
+	for (size_t index = 0; index < blocks.size(); ++index)
+	{
+		fds.push_back(blocks[index]->getFileDescriptor());
+		pBlockIds[index] = reinterpret_cast<uintptr_t>(blocks[index].get());
+	}
+	if (!extents.empty())
+	{
+		memcpy(tables.data() + blocks.size() * sizeof(uint64_t), extents.data(), extentsLength);
+	}
+	if (!inlineBytes.empty())
+	{
+		memcpy(tables.data() + blocks.size() * sizeof(uint64_t) + extentsLength, inlineBytes.data(), inlineBytes.size());
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_socket->mutex);
+		sendRecord(_socket->fd, &header, sizeof(header), fds);
+		sendRecord(_socket->fd, tables.data(), tables.size(), std::vector<int>());
+	}
+
+	// Keep the blocks until the receiver releases them
+	for (auto& pBlock : blocks)
+	{
+		auto& outstanding = _outstanding[reinterpret_cast<uintptr_t>(pBlock.get())];
+		outstanding.first = pBlock;
+		++outstanding.second;
+		++pBlock->_remoteReferences;
+	}
+}
+
+size_t SharedMemoryChannel::processReleases()
+{
+	size_t released = 0;
+	MessageHeader header;
+	while (receiveRecord(_socket->fd, &header, sizeof(header), nullptr, MSG_DONTWAIT) == sizeof(header))
+	{
+		if (header.type == kReleaseMessage)
+		{
+			release(header.blockId);
+			++released;
+		}
+	}
+	return released;
+}
+
+bool SharedMemoryChannel::receive(Buffer & buffer)
+{
+	MessageHeader header;
+	std::vector<int> fds;
+	for (;;)
+	{
+		auto received = receiveRecord(_socket->fd, &header, sizeof(header), &fds, 0);
+		if (received == 0)
+		{
+			return false;
+		}
+		if ((received == sizeof(header)) && (header.type == kBufferMessage))
+		{
+			break;
+		}
+		if ((received == sizeof(header)) && (header.type == kReleaseMessage))
+		{
+			release(header.blockId);
+		}
+		closeAll(fds);
+		fds.clear();
+	}
+
+	// The counts come from the peer, so check them before allocating room for the tables
+	if ((header.blockCount > kMaxBlocksPerBuffer) || (header.extentCount > kMaxFragmentsPerBuffer) ||
+		(header.inlineLength > header.extentCount * BufferFragment::kInlineCapacity))
+	{
+		closeAll(fds);
+		throw std::runtime_error("Malformed shared memory message");
+	}
+	auto extentsLength = header.extentCount * sizeof(Extent);
+	std::vector<char> tables(header.blockCount * sizeof(uint64_t) + extentsLength + header.inlineLength);
+	auto received = tables.empty() ? 0 : receiveRecord(_socket->fd, tables.data(), tables.size(), nullptr, 0);
+	if ((received != tables.size()) || (fds.size() != header.blockCount))
+	{
+		closeAll(fds);
+		throw std::runtime_error("Malformed shared memory message");
+	}
+
+	// Map every block first.  Each one tells the sender when it has gone.
+	auto pBlockIds = reinterpret_cast<const uint64_t*>(tables.data());
+	std::vector<std::shared_ptr<SharedMemoryBlock>> blocks;
+	for (size_t index = 0; index < fds.size(); ++index)
+	{
+		std::weak_ptr<Socket> socket{ _socket };
+		auto blockId = pBlockIds[index];
+		try
+		{
+			blocks.push_back(std::make_shared<SharedMemoryBlock>(fds[index], [socket, blockId] { sendRelease(socket, blockId); }));
+		}
+		catch (...)
+		{
+			for (auto unmapped = index + 1; unmapped < fds.size(); ++unmapped)
+			{
+				close(fds[unmapped]);
+			}
+			throw;
+		}
+	}
+
+	// The inline bytes are copied into a block, then sliced back into inline fragments
+	std::shared_ptr<IMemoryBlock> pInlineBlock;
+	if (header.inlineLength > 0)
+	{
+		auto pBlock = std::make_shared<AlignedMemoryBlock>(static_cast<size_t>(header.inlineLength), sizeof(void*));
+		memcpy(pBlock->getWritableMemory(), tables.data() + header.blockCount * sizeof(uint64_t) + extentsLength, pBlock->getLength());
+		pInlineBlock = pBlock;
+	}
+
+	Buffer result;
+	auto pExtents = reinterpret_cast<const Extent*>(tables.data() + header.blockCount * sizeof(uint64_t));
+	for (size_t index = 0; index < header.extentCount; ++index)
+	{
+		auto& extent = pExtents[index];
+		if (extent.blockIndex == kInlineExtent)
+		{
+			if (!pInlineBlock || (extent.length > BufferFragment::kInlineCapacity) ||
+				(extent.offset > header.inlineLength) || (extent.length > header.inlineLength - extent.offset))
+			{
+				throw std::runtime_error("Malformed shared memory message");
+			}
+			result += Buffer{ pInlineBlock }.slice(extent.offset, extent.length, BufferFragment::SliceMode::Inline);
+			continue;
+		}
+		if (extent.blockIndex >= blocks.size())
+		{
+			throw std::runtime_error("Malformed shared memory message");
+		}
+		result += Buffer{ blocks[extent.blockIndex] }.slice(extent.offset, extent.length);
+	}
+	buffer = result;
+	return true;
+}
+
+void SharedMemoryChannel::sendRelease(const std::weak_ptr<Socket>& socket, uint64_t blockId)
+{
+	auto pSocket = socket.lock();
+	if (!pSocket)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(pSocket->mutex);
+	if (pSocket->fd < 0)
+	{
+		return;
+	}
+	MessageHeader header{ kReleaseMessage, 0, 0, blockId, 0 };
+	try
+	{
+		sendRecord(pSocket->fd, &header, sizeof(header), std::vector<int>());
+	}
+	catch (const std::system_error&)
+	{
+		// Sender has gone, so nobody is waiting for the release
+	}
+}
+
+void SharedMemoryChannel::release(uint64_t blockId)
+{
+	auto found = _outstanding.find(blockId);
+	if (found == _outstanding.end())
+	{
+		return;
+	}
+	--found->second.first->_remoteReferences;
+	if (--found->second.second == 0)
+	{
+		_outstanding.erase(found);
+	}
+}
+
+#endif
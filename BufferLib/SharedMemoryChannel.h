@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef _WIN32
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "Buffer.h"
+#include "SharedMemoryBlock.h"
+
+	// Passes Buffers made of SharedMemoryBlocks between processes without copying.
+	// The sender passes each block's descriptor over a Unix domain socket
+	// (SCM_RIGHTS) along with the (block, offset, length) of every fragment,
+	// and the receiver maps the same pages.  When the receiver's last fragment of
+	// a block is dropped, a release message goes back so the sender knows the
+	// block is free to reuse (see SharedMemoryBlock::isInUseRemotely).
+	//
+	// The socket must be a connected AF_UNIX SOCK_SEQPACKET socket, owned by the
+	// channel from construction.  One end sends Buffers and the other receives them.
+	class SharedMemoryChannel
+	{
+	public:
+		// Most blocks one Buffer may span, limited by descriptors per message
+		static const size_t kMaxBlocksPerBuffer = 253;
+		// Most fragments one Buffer may have, which bounds what a receiver allocates
+		static const size_t kMaxFragmentsPerBuffer = 64 * 1024;
+
+		explicit SharedMemoryChannel(int socket);
+		SharedMemoryChannel(const SharedMemoryChannel&) = delete;
+		SharedMemoryChannel& operator=(const SharedMemoryChannel&) = delete;
+		~SharedMemoryChannel();
+
+		// Every fragment must be in a SharedMemoryBlock, otherwise std::invalid_argument
+		// is thrown.  Inline fragments, which only an inline slice makes, are the
+		// exception: they're already copies, so their bytes are sent in the message.
+		void send(const Buffer& buffer);
+		// Handle release messages without blocking.  Returns the number handled.
+		size_t processReleases();
+
+		// Blocks until a Buffer arrives.  Returns false if the peer has closed the socket.
+		bool receive(Buffer& buffer);
+
+	private:
+		struct Socket
+		{
+			std::mutex mutex;
+			int fd;
+		};
+
+		static void sendRelease(const std::weak_ptr<Socket>& socket, uint64_t blockId);
+		void release(uint64_t blockId);
+
+		std::shared_ptr<Socket> _socket;
+		// Blocks sent and not yet released, by id, with the number of releases due
+		std::map<uint64_t, std::pair<std::shared_ptr<SharedMemoryBlock>, size_t>> _outstanding;
+	};
+
+#endif
@@ -0,0 +1,243 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "AlignedMemoryBlock.h"
+#include "BufferMatcher.h"
+#include "TestMemoryBlock.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+// Timings are written to the test log.  Run a Release build for meaningful numbers.
+
+namespace
+{
+	// Buffer of pseudo-random lower case text, split into many fragments
+	Buffer makeFragmentedText(size_t length, size_t fragmentLength, unsigned seed)
+	{
+		auto pBlock = std::make_shared<AlignedMemoryBlock>(length, 64);
+		std::mt19937 random(seed);
+		for (size_t i = 0; i < length; ++i)
+		{
+			pBlock->getWritableMemory()[i] = static_cast<char>('a' + random() % 26);
+		}
+		return splitIntoFragments(Buffer{ pBlock }, fragmentLength);
+	}
+
+	// Hides direct access to another block, so every read is a virtual call
+	class IndirectMemoryBlock : public IMemoryBlock
+	{
+	public:
+		IndirectMemoryBlock(std::shared_ptr<IMemoryBlock> pBlock) : _block{ pBlock } {}
+		virtual const char* getMemory() const override { return nullptr; }
+		virtual size_t getLength() const override { return _block->getLength(); }
+		virtual size_t copy(size_t sourceOffset, size_t sourceLength, char* pDestination) const override
+		{
+			size_t copied = 0;
+			for (; (copied < sourceLength) && (sourceOffset + copied < getLength()); ++copied)
+			{
+				pDestination[copied] = (*_block)[sourceOffset + copied];
+			}
+			return copied;
+		}
+		virtual const char& operator[](size_t offset) const override { return (*_block)[offset]; }
+	private:
+		std::shared_ptr<IMemoryBlock> _block;
+	};
+
+	template<typename F>
+	double timeMilliseconds(F f)
+	{
+		auto start = std::chrono::steady_clock::now();
+		f();
+		auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+}
+
+	TEST_CLASS(BufferBenchmark)
+	{
+	public:
+
+		TEST_METHOD(MatcherAgainstNaiveSearch)
+		{
+			const size_t length = 256 * 1024;
+			Buffer buffer = makeFragmentedText(length, 1500, 1);
+
+			// Patterns drawn from the text so that some of them match
+			std::vector<std::string> patterns;
+			std::mt19937 random(2);
+			for (int i = 0; i < 100; ++i)
+			{
+				auto patternLength = 4 + random() % 4;
+				auto offset = random() % (length - patternLength);
+				std::string pattern(patternLength, 0);
+				buffer.copy(offset, patternLength, &pattern[0]);
+				patterns.push_back(pattern);
+			}
+
+			size_t matcherCount = 0;
+			BufferMatcher matcher(patterns);
+			auto matcherTime = timeMilliseconds([&] { matcherCount = matcher.findAll(buffer).size(); });
+
+			size_t naiveCount = 0;
+			auto naiveTime = timeMilliseconds([&] {
+				for (auto& pattern : patterns)
+				{
+					auto found = std::search(buffer.cbegin(), buffer.cend(), pattern.cbegin(), pattern.cend());
+					while (found != buffer.cend())
+					{
+						++naiveCount;
+						found = std::search(found + 1, buffer.cend(), pattern.cbegin(), pattern.cend());
+					}
+				}
+			});
+
+			std::ostringstream report;
+			report << "BufferMatcher, 100 patterns over 256KB in 1500 byte fragments: " << matcherTime
+				<< "ms, naive std::search per pattern: " << naiveTime << "ms\n";
+			Logger::WriteMessage(report.str().c_str());
+			Assert::AreEqual(matcherCount, naiveCount);
+		}
+
+		TEST_METHOD(DirectAgainstVirtualAccess)
+		{
+			const size_t length = 16 * 1024 * 1024;
+			auto pBlock = std::make_shared<AlignedMemoryBlock>(length, 64);
+			memset(pBlock->getWritableMemory(), 1, length);
+			Buffer direct = splitIntoFragments(Buffer{ pBlock }, 64 * 1024);
+			Buffer indirect = splitIntoFragments(Buffer{ std::make_shared<IndirectMemoryBlock>(pBlock) }, 64 * 1024);
+			std::vector<char> destination(length);
+
+			std::ostringstream report;
+			for (auto pBuffer : { &direct, &indirect })
+			{
+				size_t sum = 0;
+				auto iterateTime = timeMilliseconds([&] {
+					for (auto itr = pBuffer->cbegin(); itr != pBuffer->cend(); ++itr)
+					{
+						sum += *itr;
+					}
+				});
+				auto copyTime = timeMilliseconds([&] { pBuffer->copy(0, length, destination.data()); });
+				Assert::AreEqual(sum, length);
+
+				report << ((pBuffer == &direct) ? "Direct" : "Virtual") << " access, 16MB in 64KB fragments: iterate "
+					<< iterateTime << "ms, copy " << copyTime << "ms\n";
+			}
+
+			// const_itr checks for the end of the fragment on every step, so a loop over
+			// it doesn't vectorise.  A plain loop over each contiguous segment does.
+			size_t segmentSum = 0;
+			auto segmentTime = timeMilliseconds([&] {
+				size_t segmentLength = 0;
+				for (size_t offset = 0; offset < length; offset += segmentLength)
+				{
+					auto pSegment = direct.getContiguous(offset, &segmentLength);
+					for (size_t i = 0; i < segmentLength; ++i)
+					{
+						segmentSum += static_cast<unsigned char>(pSegment[i]);
+					}
+				}
+			});
+			Assert::AreEqual(segmentSum, length);
+			report << "Direct access, 16MB in 64KB fragments: iterate by segment " << segmentTime << "ms\n";
+			Logger::WriteMessage(report.str().c_str());
+		}
+
+		TEST_METHOD(ScatteredFragmentTraversal)
+		{
+			// Small fragments, each in its own block, in shuffled order, so every
+			// fragment transition is a jump the hardware prefetcher can't predict
+			const size_t fragmentLength = 512;
+			const size_t fragmentCount = 64 * 1024;
+			const size_t length = fragmentLength * fragmentCount;
+			std::vector<Buffer> pieces;
+			for (size_t i = 0; i < fragmentCount; ++i)
+			{
+				auto pBlock = std::make_shared<AlignedMemoryBlock>(fragmentLength, 64);
+				memset(pBlock->getWritableMemory(), 1, fragmentLength);
+				pieces.emplace_back(pBlock);
+			}
+			std::shuffle(pieces.begin(), pieces.end(), std::mt19937(1));
+			Buffer scattered;
+			for (auto& piece : pieces)
+			{
+				scattered += piece;
+			}
+			std::vector<char> destination(length);
+
+			// Evict the fragments from cache before each traversal
+			std::vector<char> evictor(64 * 1024 * 1024);
+			auto evict = [&evictor] {
+				for (size_t i = 0; i < evictor.size(); i += 64)
+				{
+					++evictor[i];
+				}
+			};
+
+			size_t iterateSum = 0;
+			evict();
+			auto iterateTime = timeMilliseconds([&] {
+				for (auto itr = scattered.cbegin(); itr != scattered.cend(); ++itr)
+				{
+					iterateSum += *itr;
+				}
+			});
+			evict();
+			auto copyTime = timeMilliseconds([&] { scattered.copy(0, length, destination.data()); });
+			size_t segmentSum = 0;
+			evict();
+			auto segmentTime = timeMilliseconds([&] {
+				size_t segmentLength = 0;
+				for (size_t offset = 0; offset < length; offset += segmentLength)
+				{
+					auto pSegment = scattered.getContiguous(offset, &segmentLength);
+					segmentSum += std::count(pSegment, pSegment + segmentLength, 1);
+				}
+			});
+			Assert::AreEqual(iterateSum, length);
+			Assert::AreEqual(segmentSum, length);
+
+			// The same traversals with no prefetch of the next fragment.  The byte
+			// loop steps through the fragments the way const_itr::operator++ does.
+			size_t plainIterateSum = 0;
+			evict();
+			auto plainIterateTime = timeMilliseconds([&] {
+				auto& fragments = scattered.getFragments();
+				auto fragment = fragments.cbegin();
+				size_t fragmentOffset = 0;
+				while (fragment != fragments.cend())
+				{
+					plainIterateSum += (*fragment)[fragmentOffset];
+					if (++fragmentOffset >= fragment->getLength())
+					{
+						++fragment;
+						fragmentOffset = 0;
+					}
+				}
+			});
+			size_t plainSegmentSum = 0;
+			evict();
+			auto plainSegmentTime = timeMilliseconds([&] {
+				for (auto& fragment : scattered.getFragments())
+				{
+					auto pSegment = fragment.getMemory();
+					plainSegmentSum += std::count(pSegment, pSegment + fragment.getLength(), 1);
+				}
+			});
+			Assert::AreEqual(plainIterateSum, length);
+			Assert::AreEqual(plainSegmentSum, length);
+
+			std::ostringstream report;
+			report << "Scattered access, 32MB in 512B fragments: iterate " << iterateTime << "ms (" << plainIterateTime
+				<< "ms without prefetch), copy " << copyTime << "ms, segments " << segmentTime << "ms ("
+				<< plainSegmentTime << "ms without prefetch)\n";
+			Logger::WriteMessage(report.str().c_str());
+		}
+
+	};
@@ -0,0 +1,90 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "AlignedMemoryBlock.h"
+#include "DirectFileReader.h"
+#include "TestMemoryBlock.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+	TEST_CLASS(AlignedMemoryBlockTest)
+	{
+	public:
+
+		TEST_METHOD(Alignment)
+		{
+			AlignedMemoryBlock block(1000, 4096);
+			Assert::AreEqual(block.getAlignment(), (size_t)4096);
+			Assert::AreEqual(reinterpret_cast<uintptr_t>(block.getMemory()) % 4096, (uintptr_t)0);
+			Assert::AreEqual(block.getLength(), (size_t)1000);
+
+			// Default alignment is derived from the address
+			TestMemoryBlock testBlock(&"x0123456789"[1]);
+			Assert::IsTrue(testBlock.getAlignment() >= 1);
+			Assert::AreEqual(reinterpret_cast<uintptr_t>(testBlock.getMemory()) % testBlock.getAlignment(), (uintptr_t)0);
+		}
+
+		TEST_METHOD(HugePagesFallBack)
+		{
+			// Works whether or not huge pages are available
+			const size_t length = 3 * 1024 * 1024;
+			auto pBlock = std::make_shared<AlignedMemoryBlock>(length, 4096, AlignedMemoryBlock::PageMode::HugePages);
+			memset(pBlock->getWritableMemory(), 'h', length);
+			Buffer buffer(pBlock);
+			Assert::AreEqual(buffer.getLength(), length);
+			Assert::AreEqual(buffer[length - 1], 'h');
+			Assert::AreEqual(reinterpret_cast<uintptr_t>(pBlock->getMemory()) % 4096, (uintptr_t)0);
+		}
+
+		TEST_METHOD(DirectRead)
+		{
+			const char* path = "DirectFileReaderTest.bin";
+			std::string contents;
+			for (int i = 0; i < 10000; ++i)
+			{
+				contents += static_cast<char>('a' + (i % 26));
+			}
+			{
+				std::ofstream file(path, std::ios::binary);
+				file << contents;
+			}
+
+			Buffer buffer;
+			{
+				DirectFileReader reader(path, 4096);
+				buffer = reader.readAll();
+			}
+			std::remove(path);
+
+			Assert::AreEqual(buffer.getLength(), contents.size());
+			Assert::IsTrue(std::equal(buffer.cbegin(), buffer.cend(), contents.cbegin(), contents.cend()));
+		}
+
+		TEST_METHOD(DirectReadWholeBlocks)
+		{
+			// The end of a file that's a whole number of blocks is found from its size
+			const char* path = "DirectFileReaderBlocks.bin";
+			{
+				std::ofstream file(path, std::ios::binary);
+				file << std::string(8192, 'x');
+			}
+
+			size_t blocks = 0;
+			{
+				DirectFileReader reader(path, 4096);
+				Buffer block;
+				while (reader.next(block))
+				{
+					Assert::AreEqual(block.getLength(), (size_t)4096);
+					++blocks;
+				}
+				Assert::IsFalse(reader.next(block));
+			}
+			std::remove(path);
+			Assert::AreEqual(blocks, (size_t)2);
+		}
+
+	};
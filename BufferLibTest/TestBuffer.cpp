@@ -1,10 +1,11 @@
 #include "stdafx.h"
 #include "CppUnitTest.h"
 #include "Buffer.h"
-#include "IMemoryBlock.h"
+#include "TestMemoryBlock.h"
 #include <iostream>
 #include <sstream>
 #include <algorithm>
+#include <stdexcept>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 std::ostringstream gDebug;
@@ -15,31 +16,7 @@ std::ostringstream gDebug;
 // Todo: Add some usable concrete MemoryBlock classes
 // Todo: Maybe add GTest/GMock
 // Todo: Clean-up.  Too many functions, and too much repetition.  Write functions in terms of others
-// Todo: Improve cend()
-
-class TestMemoryBlock : public IMemoryBlock
-{
-public:
-	TestMemoryBlock(const char* pContents) : _pContents{ pContents } { ++_ctorCount; }
-	virtual ~TestMemoryBlock() { ++_dtorCount; }
-
-	// Inherited via IMemoryBlock
-	virtual const char * getMemory() const override { return &_pContents[0]; }
-	virtual size_t getLength() const override { return strlen(_pContents); }
-	virtual size_t copy(size_t sourceOffset, size_t sourceLength, char * pDestination) const override
-	{
-		size_t toCopy = ((getLength() - sourceOffset) < sourceLength) ? getLength() - sourceOffset : sourceLength;
-		memcpy(pDestination, &_pContents[sourceOffset], toCopy);
-		return toCopy;
-	}
-	virtual const char & operator[](size_t offset) const override { return _pContents[offset]; }
-
-	static int _ctorCount;
-	static int _dtorCount;
-private:
-	const char* _pContents;
-	//static const char _contents[];
-};
+
 //const char TestMemoryBlock::_contents[] = "0123456789";
 int TestMemoryBlock::_ctorCount = 0;
 int TestMemoryBlock::_dtorCount = 0;
@@ -167,6 +144,122 @@ const char testContents[] = "0123456789";
 			Assert::AreEqual(strcmp(actual, expected), 0);
 		}
 
+		TEST_METHOD(Slice)
+		{
+			const char expected[] = "6789234";
+			char actual[16];
+			memset(actual, 0, 16);
+			std::shared_ptr<IMemoryBlock> pBlock{ std::make_shared<TestMemoryBlock>(testContents) };
+			Buffer buffer(pBlock);
+			buffer += buffer.slice(2, 5);
+			buffer += buffer.slice(0, 3);
+
+			Buffer buffer2 = buffer.slice(6, 7);
+			Assert::AreEqual((int)buffer2.getLength(), 7);
+			buffer2.copy(0, buffer2.getLength(), actual);
+			Assert::AreEqual(strcmp(actual, expected), 0);
+			Assert::AreEqual(buffer.slice(15, 3)[2], '2');
+		}
+
+		TEST_METHOD(SliceBeyondEnd)
+		{
+			std::shared_ptr<IMemoryBlock> pBlock{ std::make_shared<TestMemoryBlock>(testContents) };
+			Buffer buffer(pBlock);
+			Assert::AreEqual((int)buffer.slice(7, 100).getLength(), 3);
+			Assert::AreEqual((int)buffer.slice(10, 1).getLength(), 0);
+			Assert::AreEqual((int)buffer.subspan(4).getLength(), 6);
+			Assert::AreEqual(buffer.subspan(4, 2)[1], '5');
+			Buffer empty = buffer.slice(3, 0);
+			Assert::IsTrue(empty.cbegin() == empty.cend());
+		}
+
+		TEST_METHOD(SmallSliceDoesNotKeepBlock)
+		{
+			TestMemoryBlock::_ctorCount = 0;
+			TestMemoryBlock::_dtorCount = 0;
+			const char contents[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+			Buffer small;
+			Buffer large;
+			{
+				Buffer buffer(std::make_shared<TestMemoryBlock>(contents));
+				// Slices refer to the block unless inline storage is asked for
+				Assert::IsFalse(buffer.slice(3, 4).getFragments()[0].isInline());
+				auto inlineMode = BufferFragment::SliceMode::Inline;
+				small = buffer.slice(3, 4, inlineMode) + buffer.slice(30, 2, inlineMode);
+				large = buffer.slice(1, BufferFragment::kInlineCapacity + 1, inlineMode);
+			}
+			Assert::IsTrue(small.getFragments()[0].isInline());
+			Assert::IsFalse(large.getFragments()[0].isInline());
+			Assert::AreEqual(TestMemoryBlock::_dtorCount, 0);
+
+			large = Buffer();
+			// Only the inline slices are left, so the block has gone
+			Assert::AreEqual(TestMemoryBlock::_dtorCount, 1);
+			std::string expected{ "3456uv" };
+			Assert::IsTrue(std::equal(small.cbegin(), small.cend(), expected.cbegin(), expected.cend()));
+
+			// Copies and moves point at their own inline bytes
+			Buffer copied{ small };
+			Buffer moved{ std::move(small) };
+			for (int i = 0; i < 100; ++i)
+			{
+				copied += moved;
+			}
+			Assert::AreEqual(copied.getLength(), (size_t)606);
+			Assert::AreEqual(copied[605], 'v');
+			Assert::AreEqual(copied.slice(2, 3)[2], 'u');
+			Assert::IsTrue(copied.getFragments()[0].getMemory() != moved.getFragments()[0].getMemory());
+		}
+
+		TEST_METHOD(ReplaceInsertErase)
+		{
+			std::shared_ptr<IMemoryBlock> pBlock{ std::make_shared<TestMemoryBlock>(testContents) };
+			std::shared_ptr<IMemoryBlock> pInsertion{ std::make_shared<TestMemoryBlock>("-*-") };
+			Buffer buffer(pBlock);
+			Buffer insertion(pInsertion);
+
+			std::string replaced{ "012-*-6789" };
+			Buffer buffer2 = buffer.replace(3, 3, insertion);
+			Assert::IsTrue(std::equal(buffer2.cbegin(), buffer2.cend(), replaced.cbegin(), replaced.cend()));
+
+			std::string inserted{ "0123456789-*-" };
+			Buffer buffer3 = buffer.insert(10, insertion);
+			Assert::IsTrue(std::equal(buffer3.cbegin(), buffer3.cend(), inserted.cbegin(), inserted.cend()));
+
+			std::string erased{ "-*-6789" };
+			Buffer buffer4 = buffer2.erase(0, 3);
+			Assert::IsTrue(std::equal(buffer4.cbegin(), buffer4.cend(), erased.cbegin(), erased.cend()));
+
+			// Original buffer is unchanged
+			Assert::IsTrue(std::equal(buffer.cbegin(), buffer.cend(), testContents, testContents + 10));
+
+			// Edits past the end are rejected rather than appended
+			for (size_t offset : { (size_t)11, (size_t)20 })
+			{
+				bool thrown = false;
+				try
+				{
+					buffer.replace(offset, 1, insertion);
+				}
+				catch (const std::out_of_range&)
+				{
+					thrown = true;
+				}
+				Assert::IsTrue(thrown);
+			}
+
+			// An edit allocates its fragment lists once, at their final size
+			std::string contents(1000, 'x');
+			CountingMemoryResource resource;
+			Buffer fragmented{ splitIntoFragments(Buffer{ std::make_shared<TestMemoryBlock>(contents.c_str()) }, 10), &resource };
+			auto allocations = resource._allocations;
+			Buffer edited = fragmented.replace(505, 90, insertion);
+			Assert::AreEqual(resource._allocations - allocations, 2);
+			Assert::AreEqual(edited.getFragments().size(), (size_t)93);
+			Assert::AreEqual(edited.getLength(), (size_t)913);
+		}
+
 		TEST_METHOD(Iterate)
 		{
 			const char expected[] = "6789234";
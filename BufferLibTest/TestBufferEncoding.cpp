@@ -0,0 +1,137 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "AlignedMemoryBlock.h"
+#include "BufferEncoding.h"
+#include "TestMemoryBlock.h"
+#include <stdexcept>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace
+{
+	Buffer makeBuffer(const std::string& contents)
+	{
+		auto pBlock = std::make_shared<AlignedMemoryBlock>(contents.size(), 16);
+		contents.copy(pBlock->getWritableMemory(), contents.size());
+		return Buffer(pBlock);
+	}
+
+	// The same contents in fragments of fragmentLength bytes
+	Buffer makeFragmented(const std::string& contents, size_t fragmentLength)
+	{
+		return splitIntoFragments(makeBuffer(contents), fragmentLength);
+	}
+
+	std::string toString(const Buffer& buffer)
+	{
+		std::string result(buffer.getLength(), '\0');
+		if (!result.empty())
+		{
+			buffer.copy(0, result.size(), &result[0]);
+		}
+		return result;
+	}
+
+	// Every byte value, several times over, so the SIMD paths get a full run
+	std::string makeBinary(size_t length)
+	{
+		std::string result(length, '\0');
+		for (size_t i = 0; i < length; ++i)
+		{
+			result[i] = static_cast<char>((i * 7) ^ (i >> 8));
+		}
+		return result;
+	}
+}
+
+	TEST_CLASS(BufferEncodingTest)
+	{
+	public:
+
+		TEST_METHOD(HexKnownValues)
+		{
+			Assert::AreEqual(toString(encodeHex(makeBuffer(std::string("\x01\x23\xAB\xFF\0", 5)))), std::string("0123abff00"));
+			Assert::AreEqual(toString(decodeHex(makeBuffer("0123ABff00"))), std::string("\x01\x23\xAB\xFF\0", 5));
+			Assert::AreEqual(encodeHex(Buffer()).getLength(), (size_t)0);
+			Assert::AreEqual(decodeHex(Buffer()).getLength(), (size_t)0);
+		}
+
+		TEST_METHOD(Base64KnownValues)
+		{
+			const char* vectors[][2] = { { "f", "Zg==" }, { "fo", "Zm8=" }, { "foo", "Zm9v" },
+				{ "foob", "Zm9vYg==" }, { "fooba", "Zm9vYmE=" }, { "foobar", "Zm9vYmFy" } };
+			for (auto& vector : vectors)
+			{
+				Assert::AreEqual(toString(encodeBase64(makeBuffer(vector[0]))), std::string(vector[1]));
+				Assert::AreEqual(toString(decodeBase64(makeBuffer(vector[1]))), std::string(vector[0]));
+			}
+			Assert::AreEqual(toString(decodeBase64(makeBuffer("Zm9vYg"))), std::string("foob"));
+			Assert::AreEqual(toString(decodeBase64(makeBuffer("Zm9vYmE"))), std::string("fooba"));
+			Assert::AreEqual(encodeBase64(Buffer()).getLength(), (size_t)0);
+		}
+
+		TEST_METHOD(RoundTripAcrossFragments)
+		{
+			// Odd fragment lengths put hex pairs and base64 groups across fragment boundaries
+			for (size_t length : { (size_t)1, (size_t)47, (size_t)100, (size_t)1000, (size_t)4099 })
+			{
+				auto data = makeBinary(length);
+				for (size_t fragmentLength : { (size_t)1, (size_t)5, (size_t)17, (size_t)4096 })
+				{
+					auto hex = encodeHex(makeFragmented(data, fragmentLength));
+					Assert::AreEqual(hex.getLength(), length * 2);
+					Assert::AreEqual(toString(decodeHex(makeFragmented(toString(hex), fragmentLength))), data);
+
+					auto base64 = encodeBase64(makeFragmented(data, fragmentLength));
+					Assert::AreEqual(toString(base64), toString(encodeBase64(makeBuffer(data))));
+					Assert::AreEqual(toString(decodeBase64(makeFragmented(toString(base64), fragmentLength))), data);
+				}
+			}
+		}
+
+		TEST_METHOD(IndirectMemoryBlock)
+		{
+			// TestMemoryBlock contents are read through getContiguous like any other block
+			Buffer buffer(std::make_shared<TestMemoryBlock>("Zm9v"));
+			buffer += Buffer(std::make_shared<TestMemoryBlock>("YmFy"));
+			Assert::AreEqual(toString(decodeBase64(buffer)), std::string("foobar"));
+		}
+
+		TEST_METHOD(InvalidInput)
+		{
+			auto longHex = toString(encodeHex(makeBuffer(makeBinary(100))));
+			longHex[70] = 'g';
+			auto longBase64 = toString(encodeBase64(makeBuffer(makeBinary(100))));
+			longBase64[50] = '-';
+
+			for (auto& invalid : { std::string("abc"), std::string("0x"), longHex })
+			{
+				for (size_t fragmentLength : { (size_t)3, (size_t)4096 })
+				{
+					bool thrown = false;
+					try { decodeHex(makeFragmented(invalid, fragmentLength)); }
+					catch (std::invalid_argument&) { thrown = true; }
+					Assert::IsTrue(thrown);
+				}
+			}
+			for (auto& invalid : { std::string("Zm9vY"), std::string("Zm=v"), std::string("Zm9v\nYmF"), std::string("Zh=="), std::string("Zm9="), std::string("Zh"), longBase64 })
+			{
+				for (size_t fragmentLength : { (size_t)3, (size_t)4096 })
+				{
+					bool thrown = false;
+					try { decodeBase64(makeFragmented(invalid, fragmentLength)); }
+					catch (std::invalid_argument&) { thrown = true; }
+					Assert::IsTrue(thrown);
+				}
+			}
+		}
+
+		TEST_METHOD(OutputFromResource)
+		{
+			MonotonicMemoryResource arena(4096);
+			auto encoded = encodeBase64(makeBuffer("foobar"), &arena);
+			Assert::IsTrue(encoded.getMemoryResource() == &arena);
+			Assert::AreEqual(toString(encoded), std::string("Zm9vYmFy"));
+		}
+	};
@@ -0,0 +1,139 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "BufferFile.h"
+#include "TestMemoryBlock.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+	TEST_CLASS(BufferFileTest)
+	{
+	public:
+
+		TEST_METHOD(SaveAndLoad)
+		{
+			const char* path = "BufferFileTest.buf";
+			std::shared_ptr<IMemoryBlock> pBlock{ std::make_shared<TestMemoryBlock>("0123456789") };
+			std::shared_ptr<IMemoryBlock> pOther{ std::make_shared<TestMemoryBlock>("abcdef") };
+			Buffer buffer(pBlock);
+			buffer = buffer + buffer.slice(2, 5) + Buffer{ pOther }.slice(1, 2) + buffer;
+			std::string expected{ "012345678923456bc0123456789" };
+
+			saveBuffer(buffer, path);
+			{
+				Buffer loaded = loadBuffer(path);
+				// Read-ahead hints, including ones running past the end, leave the contents alone
+				loaded.willNeed(3, 20);
+				loaded.willNeed(0, 1000);
+				loaded.willNeed(100, 1);
+				Assert::IsTrue(std::equal(loaded.cbegin(), loaded.cend(), expected.cbegin(), expected.cend()));
+			}
+
+			// Each block is stored once, the parts of it in use merged together
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			Assert::AreEqual(static_cast<size_t>(file.tellg()), kBufferFilePayloadAlignment * 2 + 2);
+			file.close();
+			std::remove(path);
+		}
+
+		TEST_METHOD(SaveSkipsGaps)
+		{
+			const char* path = "BufferFileGaps.buf";
+			std::string contents(100000, '-');
+			contents.replace(0, 15, "abcdefghijklmno");
+			contents.replace(99990, 10, "0123456789");
+			Buffer buffer{ std::make_shared<TestMemoryBlock>(contents.c_str()) };
+			// Slices from both ends of the block, one overlapping another
+			buffer = buffer.slice(0, 10) + buffer.slice(99990, 10) + buffer.slice(5, 10);
+			std::string expected{ "abcdefghij0123456789fghijklmno" };
+
+			saveBuffer(buffer, path);
+			{
+				Buffer loaded = loadBuffer(path);
+				Assert::IsTrue(std::equal(loaded.cbegin(), loaded.cend(), expected.cbegin(), expected.cend()));
+			}
+
+			// Only the 25 bytes in use are stored, not the gap between them
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			Assert::AreEqual(static_cast<size_t>(file.tellg()), kBufferFilePayloadAlignment + 25);
+			file.close();
+			std::remove(path);
+		}
+
+		TEST_METHOD(SaveInlineFragments)
+		{
+			const char* path = "BufferFileInline.buf";
+			std::shared_ptr<IMemoryBlock> pBlock{ std::make_shared<TestMemoryBlock>("0123456789") };
+			Buffer buffer(pBlock);
+			auto inlineMode = BufferFragment::SliceMode::Inline;
+			buffer = buffer.slice(7, 2, inlineMode) + buffer + buffer.slice(1, 3, inlineMode);
+			std::string expected{ "780123456789123" };
+
+			saveBuffer(buffer, path);
+			{
+				Buffer loaded = loadBuffer(path);
+				Assert::IsTrue(std::equal(loaded.cbegin(), loaded.cend(), expected.cbegin(), expected.cend()));
+			}
+
+			// The inline fragments' bytes are stored together, as if they were one block
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			Assert::AreEqual(static_cast<size_t>(file.tellg()), kBufferFilePayloadAlignment * 2 + 10);
+			file.close();
+			std::remove(path);
+		}
+
+		TEST_METHOD(LoadRejectsOtherFiles)
+		{
+			const char* path = "BufferFileTest.txt";
+			{
+				std::ofstream file(path, std::ios::binary);
+				file << "This is not a buffer file, but it is long enough to have a header";
+			}
+			bool thrown = false;
+			try
+			{
+				loadBuffer(path);
+			}
+			catch (const std::runtime_error&)
+			{
+				thrown = true;
+			}
+			std::remove(path);
+			Assert::IsTrue(thrown);
+		}
+
+		TEST_METHOD(LoadRejectsOverflowingExtent)
+		{
+			const char* path = "BufferFileOverflow.buf";
+			saveBuffer(Buffer{ std::make_shared<TestMemoryBlock>("0123456789") }, path);
+			{
+				// Offset 2 and a length that wraps the sum round to 0, with the total
+				// length the truncated slice would have.  The extent table follows the
+				// 40 byte header and the one block entry.
+				std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+				uint64_t extent[2] = { 2, UINT64_MAX - 1 };
+				file.seekp(40 + 16 + 8);
+				file.write(reinterpret_cast<const char*>(extent), sizeof(extent));
+				uint64_t totalLength = 8;
+				file.seekp(32);
+				file.write(reinterpret_cast<const char*>(&totalLength), sizeof(totalLength));
+			}
+			bool thrown = false;
+			try
+			{
+				loadBuffer(path);
+			}
+			catch (const std::runtime_error&)
+			{
+				thrown = true;
+			}
+			std::remove(path);
+			Assert::IsTrue(thrown);
+		}
+
+	};
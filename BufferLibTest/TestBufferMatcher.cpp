@@ -0,0 +1,61 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "BufferMatcher.h"
+#include "TestMemoryBlock.h"
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+	TEST_CLASS(BufferMatcherTest)
+	{
+	public:
+
+		TEST_METHOD(OverlappingPatterns)
+		{
+			BufferMatcher matcher({ "he", "she", "his", "hers" });
+			Buffer buffer(std::make_shared<TestMemoryBlock>("ushers"));
+			auto matches = matcher.findAll(buffer);
+
+			Assert::AreEqual(matches.size(), (size_t)3);
+			Assert::AreEqual(matches[0].patternIndex, (size_t)1);
+			Assert::AreEqual(matches[0].offset, (size_t)1);
+			Assert::AreEqual(matches[1].patternIndex, (size_t)0);
+			Assert::AreEqual(matches[1].offset, (size_t)2);
+			Assert::AreEqual(matches[2].patternIndex, (size_t)3);
+			Assert::AreEqual(*(buffer.cbegin() + matches[2].offset), 'h');
+		}
+
+		TEST_METHOD(MatchAcrossFragments)
+		{
+			BufferMatcher matcher({ "6789234", "9" });
+			std::shared_ptr<IMemoryBlock> pBlock{ std::make_shared<TestMemoryBlock>("0123456789") };
+			Buffer buffer(pBlock);
+			buffer += buffer.slice(2, 5);
+			auto matches = matcher.findAll(buffer);
+
+			Assert::AreEqual(matches.size(), (size_t)2);
+			Assert::AreEqual(matches[0].patternIndex, (size_t)1);
+			Assert::AreEqual(matches[1].patternIndex, (size_t)0);
+			Assert::AreEqual(matches[1].offset, (size_t)6);
+		}
+
+		TEST_METHOD(MatchAcrossBuffers)
+		{
+			BufferMatcher matcher({ "defg" });
+			Buffer first(std::make_shared<TestMemoryBlock>("abcde"));
+			Buffer second(std::make_shared<TestMemoryBlock>("fgdefg"));
+
+			std::vector<BufferMatcher::Match> matches;
+			BufferMatcher::State state;
+			auto onMatch = [&matches](const BufferMatcher::Match& match) { matches.push_back(match); };
+			matcher.scan(first, state, onMatch);
+			Assert::AreEqual(matches.size(), (size_t)0);
+			matcher.scan(second, state, onMatch);
+
+			Assert::AreEqual(state.getStreamOffset(), (size_t)11);
+			Assert::AreEqual(matches.size(), (size_t)2);
+			Assert::AreEqual(matches[0].offset, (size_t)3);
+			Assert::AreEqual(matches[1].offset, (size_t)7);
+		}
+
+	};
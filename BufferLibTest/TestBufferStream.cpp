@@ -0,0 +1,142 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "BufferStream.h"
+#include "TestMemoryBlock.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace
+{
+	std::shared_ptr<BufferQueue> makeSource(std::vector<const char*> contents)
+	{
+		auto pQueue = std::make_shared<BufferQueue>(contents.size());
+		for (auto pContents : contents)
+		{
+			pQueue->push(Buffer{ std::make_shared<TestMemoryBlock>(pContents) });
+		}
+		pQueue->close();
+		return pQueue;
+	}
+
+	bool equals(const Buffer& buffer, const std::string& expected)
+	{
+		return std::equal(buffer.cbegin(), buffer.cend(), expected.cbegin(), expected.cend());
+	}
+}
+
+	TEST_CLASS(BufferStreamTest)
+	{
+	public:
+
+		TEST_METHOD(Map)
+		{
+			MapStream stream(makeSource({ "0123456789", "abcdef" }), [](Buffer buffer) { return buffer.slice(1, 3); });
+			Buffer buffer;
+			Assert::IsTrue(stream.next(buffer));
+			Assert::IsTrue(equals(buffer, "123"));
+			Assert::IsTrue(stream.next(buffer));
+			Assert::IsTrue(equals(buffer, "bcd"));
+			Assert::IsFalse(stream.next(buffer));
+		}
+
+		TEST_METHOD(Split)
+		{
+			SplitStream stream(makeSource({ "ab,cd", "e", "f,", ",gh" }), ',');
+			std::vector<std::string> expected{ "ab", "cdef", "", "gh" };
+			Buffer buffer;
+			for (auto& record : expected)
+			{
+				Assert::IsTrue(stream.next(buffer));
+				Assert::IsTrue(equals(buffer, record));
+			}
+			Assert::IsFalse(stream.next(buffer));
+		}
+
+		TEST_METHOD(ConcatenateAndBatch)
+		{
+			auto pConcatenated = std::make_shared<ConcatenateStream>(std::vector<std::shared_ptr<BufferStream>>{
+				makeSource({ "abc", "de" }), makeSource({ "fghij", "k" }) });
+			BatchStream stream(pConcatenated, 4);
+			Buffer buffer;
+			Assert::IsTrue(stream.next(buffer));
+			Assert::IsTrue(equals(buffer, "abcde"));
+			Assert::IsTrue(stream.next(buffer));
+			Assert::IsTrue(equals(buffer, "fghij"));
+			Assert::IsTrue(stream.next(buffer));
+			Assert::IsTrue(equals(buffer, "k"));
+			Assert::IsFalse(stream.next(buffer));
+
+			bool thrown = false;
+			try { BatchStream empty(makeSource({ "abc" }), 0); }
+			catch (std::invalid_argument&) { thrown = true; }
+			Assert::IsTrue(thrown);
+		}
+
+		TEST_METHOD(ExecutorOverlapsStages)
+		{
+			// Both stages run on this thread, one buffer at a time each, through a
+			// queue with room for a single buffer
+			std::string log;
+			auto pMapped = std::make_shared<MapStream>(makeSource({ "a,", "b,", "c,", "d" }),
+				[&log](Buffer buffer) { log += 'm'; return buffer; });
+			auto pQueue = std::make_shared<BufferQueue>(1);
+			std::vector<std::string> records;
+			StreamExecutor executor;
+			executor.pump(pMapped, pQueue);
+			executor.drain(std::make_shared<SplitStream>(pQueue, ','), [&](Buffer buffer) {
+				log += 'd';
+				records.push_back(std::string(buffer.cbegin(), buffer.cend()));
+			});
+			executor.run();
+
+			Assert::IsTrue(executor.isIdle());
+			Assert::AreEqual(log, std::string("mdmdmdmd"));
+			Assert::IsTrue(records == std::vector<std::string>({ "a", "b", "c", "d" }));
+		}
+
+		TEST_METHOD(QueueTryNext)
+		{
+			BufferQueue queue(1);
+			Buffer buffer{ std::make_shared<TestMemoryBlock>("abc") };
+			Assert::IsTrue(queue.tryNext(buffer) == BufferStream::Poll::Pending);
+			Assert::IsTrue(queue.tryPush(buffer));
+			Buffer second{ std::make_shared<TestMemoryBlock>("de") };
+			Assert::IsFalse(queue.tryPush(second));
+			Assert::AreEqual(second.getLength(), (size_t)2);
+
+			Buffer received;
+			Assert::IsTrue(queue.tryNext(received) == BufferStream::Poll::Ready);
+			Assert::IsTrue(equals(received, "abc"));
+			queue.close();
+			Assert::IsTrue(queue.tryNext(received) == BufferStream::Poll::Done);
+		}
+
+		TEST_METHOD(QueueBackpressure)
+		{
+			// Producer thread can only run one buffer ahead of the consumer
+			BufferQueue queue(1);
+			std::shared_ptr<IMemoryBlock> pBlock{ std::make_shared<TestMemoryBlock>("0123456789") };
+			std::thread producer([&] {
+				for (size_t i = 0; i < 10; ++i)
+				{
+					queue.push(Buffer{ pBlock }.slice(i, 1));
+				}
+				queue.close();
+			});
+
+			std::string received;
+			Buffer buffer;
+			while (queue.next(buffer))
+			{
+				received += buffer[0];
+			}
+			producer.join();
+			Assert::IsTrue(received == "0123456789");
+		}
+
+	};
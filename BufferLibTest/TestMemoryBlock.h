@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Buffer.h"
+#include "IMemoryBlock.h"
+#include "MemoryResource.h"
+#include <cstring>
+
+// Memory block over a constant string, counting constructions and destructions
+class TestMemoryBlock : public IMemoryBlock
+{
+public:
+	TestMemoryBlock(const char* pContents) : _pContents{ pContents } { ++_ctorCount; }
+	virtual ~TestMemoryBlock() { ++_dtorCount; }
+
+	// Inherited via IMemoryBlock
+	virtual const char * getMemory() const override { return &_pContents[0]; }
+	virtual size_t getLength() const override { return strlen(_pContents); }
+	virtual size_t copy(size_t sourceOffset, size_t sourceLength, char * pDestination) const override
+	{
+		size_t toCopy = ((getLength() - sourceOffset) < sourceLength) ? getLength() - sourceOffset : sourceLength;
+		memcpy(pDestination, &_pContents[sourceOffset], toCopy);
+		return toCopy;
+	}
+	virtual const char & operator[](size_t offset) const override { return _pContents[offset]; }
+
+	static int _ctorCount;
+	static int _dtorCount;
+private:
+	const char* _pContents;
+	//static const char _contents[];
+};
+
+// The same contents as whole, cut into fragments of fragmentLength bytes
+inline Buffer splitIntoFragments(const Buffer& whole, size_t fragmentLength)
+{
+	Buffer result;
+	for (size_t offset = 0; offset < whole.getLength(); offset += fragmentLength)
+	{
+		result += whole.slice(offset, fragmentLength);
+	}
+	return result;
+}
+
+// Passes through to the default resource, counting what is outstanding
+class CountingMemoryResource : public IMemoryResource
+{
+public:
+	CountingMemoryResource() : _allocations{ 0 }, _outstanding{ 0 } {}
+
+	virtual void* allocate(size_t bytes, size_t alignment) override
+	{
+		++_allocations;
+		++_outstanding;
+		return getDefaultMemoryResource()->allocate(bytes, alignment);
+	}
+	virtual void deallocate(void* pMemory, size_t bytes, size_t alignment) override
+	{
+		--_outstanding;
+		getDefaultMemoryResource()->deallocate(pMemory, bytes, alignment);
+	}
+
+	int _allocations;
+	int _outstanding;
+};
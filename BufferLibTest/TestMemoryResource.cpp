@@ -0,0 +1,74 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "Buffer.h"
+#include "MemoryResource.h"
+#include "TestMemoryBlock.h"
+#include <algorithm>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+	TEST_CLASS(MemoryResourceTest)
+	{
+	public:
+
+		TEST_METHOD(BufferUsesResource)
+		{
+			CountingMemoryResource resource;
+			{
+				auto pBlock = makeMemoryBlock<TestMemoryBlock>(&resource, "0123456789");
+				Assert::AreEqual(resource._allocations, 1);
+
+				Buffer buffer(pBlock, &resource);
+				Buffer sub = buffer.slice(2, 5);
+				Buffer joined = sub + buffer;
+				Assert::IsTrue(sub.getMemoryResource() == &resource);
+				Assert::IsTrue(joined.getMemoryResource() == &resource);
+				Assert::IsTrue(Buffer(joined, joined.cbegin() + 1).getMemoryResource() == &resource);
+
+				std::string expected{ "234560123456789" };
+				Assert::IsTrue(std::equal(joined.cbegin(), joined.cend(), expected.cbegin(), expected.cend()));
+
+				// Plain copies go to the global heap, so they can outlive an arena
+				Buffer plain(joined);
+				Assert::IsTrue(plain.getMemoryResource() == getDefaultMemoryResource());
+
+				// Copy back out to the global heap
+				Buffer copied(joined, getDefaultMemoryResource());
+				Assert::IsTrue(copied.getMemoryResource() == getDefaultMemoryResource());
+				Assert::IsTrue(std::equal(copied.cbegin(), copied.cend(), expected.cbegin(), expected.cend()));
+
+				// Sub-buffers and edits can be moved to another resource too
+				auto pDefault = getDefaultMemoryResource();
+				Assert::IsTrue(Buffer(joined, joined.cbegin() + 1, pDefault).getMemoryResource() == pDefault);
+				Assert::IsTrue(Buffer(joined, joined.cbegin() + 1, joined.cend(), pDefault).getMemoryResource() == pDefault);
+				Assert::IsTrue(joined.replace(1, 2, buffer, pDefault).getMemoryResource() == pDefault);
+				Assert::IsTrue(joined.insert(1, buffer, pDefault).getMemoryResource() == pDefault);
+				Assert::IsTrue(joined.erase(1, 2, pDefault).getMemoryResource() == pDefault);
+				Assert::IsTrue(joined.erase(1, 2).getMemoryResource() == &resource);
+			}
+			Assert::AreEqual(resource._outstanding, 0);
+		}
+
+		TEST_METHOD(MonotonicArena)
+		{
+			char initial[256];
+			MonotonicMemoryResource arena(initial, sizeof(initial));
+			{
+				Buffer buffer(makeMemoryBlock<TestMemoryBlock>(&arena, "abcdefghijklmnopqrstuvwxyz"), &arena);
+				Buffer result(&arena);
+				for (size_t i = 0; i < 26; i += 2)
+				{
+					result += buffer.slice(i, 1);
+				}
+				std::string expected{ "acegikmoqsuwy" };
+				Assert::IsTrue(std::equal(result.cbegin(), result.cend(), expected.cbegin(), expected.cend()));
+			}
+			arena.release();
+
+			auto pFirst = arena.allocate(16, 16);
+			Assert::AreEqual(reinterpret_cast<uintptr_t>(pFirst) % 16, (uintptr_t)0);
+			Assert::AreEqual(reinterpret_cast<uintptr_t>(arena.allocate(100, 64)) % 64, (uintptr_t)0);
+		}
+
+	};
@@ -0,0 +1,126 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "RingMemoryBlock.h"
+#include "TestMemoryBlock.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace
+{
+	// Write text to the ring's free space
+	void write(RingMemoryBlock& ring, const std::string& text)
+	{
+		char* pSpans[2];
+		size_t lengths[2];
+		auto spanCount = ring.getWritableSpans(pSpans, lengths);
+		size_t written = 0;
+		for (size_t index = 0; (index < spanCount) && (written < text.size()); ++index)
+		{
+			auto length = std::min(lengths[index], text.size() - written);
+			memcpy(pSpans[index], text.data() + written, length);
+			written += length;
+		}
+		ring.commit(written);
+	}
+
+	bool equals(const Buffer& buffer, const std::string& expected)
+	{
+		return std::equal(buffer.cbegin(), buffer.cend(), expected.cbegin(), expected.cend());
+	}
+}
+
+	TEST_CLASS(RingMemoryBlockTest)
+	{
+	public:
+
+		TEST_METHOD(WrapAroundAsTwoFragments)
+		{
+			auto pRing = RingMemoryBlock::create(16, false);
+			Assert::IsFalse(pRing->isMirrored());
+
+			write(*pRing, "0123456789ab");
+			{
+				Buffer first = pRing->take(10);
+				Assert::IsTrue(equals(first, "0123456789"));
+				Assert::AreEqual(pRing->getFreeLength(), (size_t)4);
+			}
+			// Released, so the space is free again
+			Assert::AreEqual(pRing->getFreeLength(), (size_t)14);
+
+			write(*pRing, "cdefghij");
+			Buffer wrapped = pRing->take(10);
+			Assert::IsTrue(equals(wrapped, "abcdefghij"));
+			Assert::AreEqual(wrapped.getFragments().size(), (size_t)2);
+		}
+
+		TEST_METHOD(MirroredWrapAroundIsOneFragment)
+		{
+			auto pRing = RingMemoryBlock::create(4096);
+			std::string block(3000, 'x');
+			write(*pRing, block);
+			pRing->take(3000);
+			write(*pRing, block);
+			Buffer wrapped = pRing->take(3000);
+			Assert::IsTrue(equals(wrapped, block));
+			Assert::AreEqual(wrapped.getFragments().size(), pRing->isMirrored() ? (size_t)1 : (size_t)2);
+		}
+
+		TEST_METHOD(TakeAllocatesOnlyFragmentLists)
+		{
+			CountingMemoryResource resource;
+			for (auto mirrored : { true, false })
+			{
+				auto pRing = RingMemoryBlock::create(4096, mirrored);
+				resource._allocations = 0;
+				// 1000 is not a factor of the capacity, so some takes wrap
+				std::string record(1000, 'r');
+				for (int i = 0; i < 1000; ++i)
+				{
+					write(*pRing, record);
+					Buffer taken = pRing->take(record.size(), &resource);
+					Assert::IsTrue(equals(taken, record));
+				}
+				Assert::AreEqual(resource._allocations, 2000);
+				Assert::AreEqual(resource._outstanding, 0);
+			}
+		}
+
+		TEST_METHOD(ReclaimOldestFirst)
+		{
+			auto pRing = RingMemoryBlock::create(16, false);
+			write(*pRing, "0123456789abcdef");
+			Buffer first = pRing->take(4);
+			Buffer second = pRing->take(4);
+			Assert::AreEqual(pRing->getFreeLength(), (size_t)0);
+
+			// Second is released but first still holds the oldest space
+			second = Buffer{};
+			Assert::AreEqual(pRing->getFreeLength(), (size_t)0);
+			first = Buffer{};
+			Assert::AreEqual(pRing->getFreeLength(), (size_t)8);
+			Assert::AreEqual(pRing->getReceivedLength(), (size_t)8);
+		}
+
+#ifndef _WIN32
+		TEST_METHOD(ReceiveFromDescriptor)
+		{
+			int fds[2];
+			Assert::AreEqual(pipe(fds), 0);
+			auto pRing = RingMemoryBlock::create(4096);
+			std::string message{ "hello ring" };
+			Assert::AreEqual(write(fds[1], message.data(), message.size()), (ssize_t)message.size());
+
+			Assert::AreEqual(pRing->receive(fds[0]), (long)message.size());
+			Assert::IsTrue(equals(pRing->take(pRing->getReceivedLength()), message));
+			close(fds[0]);
+			close(fds[1]);
+		}
+#endif
+
+	};
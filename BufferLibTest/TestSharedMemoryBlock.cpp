@@ -0,0 +1,156 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "SharedMemoryBlock.h"
+#include "SharedMemoryChannel.h"
+#include "TestMemoryBlock.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+	TEST_CLASS(SharedMemoryBlockTest)
+	{
+	public:
+
+		TEST_METHOD(CreateAndWrite)
+		{
+			auto pBlock = std::make_shared<SharedMemoryBlock>(11);
+			memcpy(pBlock->getWritableMemory(), "hello world", 11);
+			Buffer buffer(pBlock);
+			Assert::AreEqual((int)buffer.getLength(), 11);
+			Assert::AreEqual(buffer[6], 'w');
+			Assert::IsFalse(pBlock->isInUseRemotely());
+		}
+
+#ifndef _WIN32
+		TEST_METHOD(SendAndRelease)
+		{
+			int sockets[2];
+			Assert::AreEqual(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets), 0);
+			SharedMemoryChannel sender(sockets[0]);
+			SharedMemoryChannel receiver(sockets[1]);
+
+			auto pBlock = std::make_shared<SharedMemoryBlock>(11);
+			memcpy(pBlock->getWritableMemory(), "hello world", 11);
+			Buffer buffer(pBlock);
+			sender.send(buffer.slice(6, 5) + buffer.slice(5, 1) + buffer.slice(0, 5));
+			Assert::IsTrue(pBlock->isInUseRemotely());
+
+			{
+				Buffer received;
+				Assert::IsTrue(receiver.receive(received));
+				std::string expected{ "world hello" };
+				Assert::IsTrue(std::equal(received.cbegin(), received.cend(), expected.cbegin(), expected.cend()));
+
+				// Same pages, not a copy
+				pBlock->getWritableMemory()[0] = 'j';
+				Assert::AreEqual(received[6], 'j');
+
+				Assert::AreEqual(sender.processReleases(), (size_t)0);
+				Assert::IsTrue(pBlock->isInUseRemotely());
+			}
+			Assert::AreEqual(sender.processReleases(), (size_t)1);
+			Assert::IsFalse(pBlock->isInUseRemotely());
+		}
+
+		TEST_METHOD(SendRejectsOtherBlocks)
+		{
+			int sockets[2];
+			Assert::AreEqual(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets), 0);
+			SharedMemoryChannel sender(sockets[0]);
+			SharedMemoryChannel receiver(sockets[1]);
+			Buffer buffer(std::make_shared<TestMemoryBlock>("0123456789"));
+
+			bool thrown = false;
+			try
+			{
+				sender.send(buffer);
+			}
+			catch (const std::invalid_argument&)
+			{
+				thrown = true;
+			}
+			Assert::IsTrue(thrown);
+
+			// Inline slices are copies, so they can be sent from any block
+			sender.send(buffer.slice(2, 3, BufferFragment::SliceMode::Inline));
+			Buffer received;
+			Assert::IsTrue(receiver.receive(received));
+			std::string expected{ "234" };
+			Assert::IsTrue(std::equal(received.cbegin(), received.cend(), expected.cbegin(), expected.cend()));
+		}
+
+		TEST_METHOD(ReceiveRejectsHugeCounts)
+		{
+			int sockets[2];
+			Assert::AreEqual(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets), 0);
+			SharedMemoryChannel receiver(sockets[1]);
+
+			// A buffer message header claiming far more extents than could be sent
+			struct
+			{
+				uint32_t type;
+				uint32_t blockCount;
+				uint64_t extentCount;
+				uint64_t blockId;
+				uint64_t inlineLength;
+			} header = { 1, 0, (uint64_t)1 << 40, 0, 0 };
+			Assert::AreEqual(send(sockets[0], &header, sizeof(header), 0), (ssize_t)sizeof(header));
+			bool thrown = false;
+			try
+			{
+				Buffer received;
+				receiver.receive(received);
+			}
+			catch (const std::runtime_error&)
+			{
+				thrown = true;
+			}
+			close(sockets[0]);
+			Assert::IsTrue(thrown);
+		}
+
+		TEST_METHOD(ReceiveRejectsTruncatedTables)
+		{
+			int sockets[2];
+			Assert::AreEqual(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets), 0);
+			SharedMemoryChannel receiver(sockets[1]);
+
+			// One inline extent of "abc", but the tables record is longer than the
+			// header says, so reading what the header says truncates it
+			struct
+			{
+				uint32_t type;
+				uint32_t blockCount;
+				uint64_t extentCount;
+				uint64_t blockId;
+				uint64_t inlineLength;
+			} header = { 1, 0, 1, 0, 3 };
+			Assert::AreEqual(send(sockets[0], &header, sizeof(header), 0), (ssize_t)sizeof(header));
+			char tables[64] = {};
+			const uint64_t extent[3] = { UINT64_MAX, 0, 3 };
+			memcpy(tables, extent, sizeof(extent));
+			memcpy(tables + sizeof(extent), "abc", 3);
+			Assert::AreEqual(send(sockets[0], tables, sizeof(tables), 0), (ssize_t)sizeof(tables));
+			bool thrown = false;
+			try
+			{
+				Buffer received;
+				receiver.receive(received);
+			}
+			catch (const std::runtime_error&)
+			{
+				thrown = true;
+			}
+			close(sockets[0]);
+			Assert::IsTrue(thrown);
+		}
+#endif
+
+	};